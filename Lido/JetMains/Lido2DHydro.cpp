@@ -9,23 +9,41 @@
 #include <boost/filesystem/fstream.hpp>
 #include <boost/program_options.hpp>
 #include <sstream>
+#include <memory>
+#include <thread>
 #include <unistd.h>
 
 #include "simpleLogger.h"
 #include "Medium_Reader.h"
 #include "lido.h"
 #include "pythia_jet_gen.h"
+#include "parallel_pythia.h"
+#include "event_library.h"
 #include "Hadronize.h"
 #include "jet_finding.h"
+#include "particle_store.h"
 
 namespace po = boost::program_options;
 namespace fs = boost::filesystem;
 
 struct event{
     std::vector<particle> plist, thermal_list, hlist;
+    // partons in transport, filled from hard and dumped into plist
+    ParticleStore partons;
     std::vector<current> clist;
     double sigma, Q0, maxPT;
     fourvec x0;
+    // evolution and analysis are done, only plist is left
+    bool finished;
+    // the vacuum partons, shared by the angular oversamples of a hard 
+    // event; an oversample rotates them by phi around the beam axis and
+    // moves them to the vertex (x, y) as they enter its parton store
+    std::shared_ptr<const std::vector<particle> > hard;
+    double vertex_x, vertex_y, phi;
+    // jets and heavy flavors found when the event finished, they are
+    // added to the statistics in the order of the events
+    std::vector<Fjet> jets;
+    std::vector<particle> HFs;
 };
 
 int main(int argc, char* argv[]){
@@ -33,7 +51,8 @@ int main(int argc, char* argv[]){
     OptDesc options{};
     options.add_options()
     ("help", "show this help message and exit")
-    ("pythia-setting,y", po::value<fs::path>()->value_name("PATH")->required(),"Pythia setting file")
+    ("pythia-setting,y", po::value<fs::path>()->value_name("PATH"),"Pythia setting file")
+    ("event-library", po::value<fs::path>()->value_name("PATH"),"read the hard events from an event library (see Lido_pp --write-events) instead of running Pythia")
     ("pythia-events,n", po::value<int>()->value_name("INT")->default_value(100,"100"),"number of Pythia events")
     ("angular-oversample", po::value<int>()->value_name("INT")->default_value(1,"1"),"number of angular oversamples")
     ("ic,i", po::value<fs::path>()->value_name("PATH")->required(),"trento initial condition file")
@@ -50,7 +69,12 @@ int main(int argc, char* argv[]){
     ("theta", po::value<double>()->value_name("DOUBLE")->default_value(4.,"4."),"Emin/T")
     ("afix", po::value<double>()->value_name("DOUBLE")->default_value(-1.,"-1."), "fixed alpha_s, <0 for running alphas")
     ("cut",po::value<double>()->value_name("DOUBLE")->default_value(4.,"4."),"cut between diffusion and scattering, Qc^2 = cut*mD^2")
-    ("Tf", po::value<double>()->value_name("DOUBLE")->default_value(0.17,"0.17"),"Transport stopping temperature, Tf");
+    ("Tf", po::value<double>()->value_name("DOUBLE")->default_value(0.17,"0.17"),"Transport stopping temperature, Tf")
+    ("analysis-threads", po::value<int>()->value_name("INT")->default_value(1,"1"),"number of threads for the jet analysis of finished events, they run alongside the evolution")
+    ("batch-size", po::value<int>()->value_name("INT")->default_value(0,"0"),"number of events evolved at a time, 0 for all events at once. Every batch reads the hydro file again and writes <pid>-partons-<batch>.dat instead of <pid>-partons.dat")
+    ("pthat-bias", po::value<double>()->value_name("DOUBLE")->default_value(0.,"0"),"sample all trigger bins with one Pythia generator biased by pThat^power, 0 for one generator per bin")
+    ("gen-threads", po::value<int>()->value_name("INT")->default_value(1,"1"),"number of threads (Pythia instances) for the hard event generation")
+    ("seed", po::value<int>()->value_name("INT")->default_value(-1,"-1"),"master random seed of the event generation, <0 for the process id");
 
     po::variables_map args{};
     try{
@@ -99,8 +123,14 @@ int main(int argc, char* argv[]){
                 return 1;
             }
         }
-        // check pythia setting
-        if (!args.count("pythia-setting")){
+        // check pythia setting, not needed with an event library
+        if (args.count("event-library")){
+            if (!fs::exists(args["event-library"].as<fs::path>())) {
+                throw po::error{"<event-library> path does not exist"};
+                return 1;
+            }
+        }
+        else if (!args.count("pythia-setting")){
             throw po::required_option{"<pythia-setting>"};
             return 1;
         }
@@ -166,111 +196,310 @@ int main(int argc, char* argv[]){
 //        charm_diffusion_table->read("/Users/yufu/qhat_result.txt");
         charm_diffusion_table->read("./../qhat_Tmatrix/qhat_result.txt");
         bottom_diffusion_table->read("/Users/yufu/qhat_result.txt");
-        // Initialzie a hydro reader
-        Medium<2> med1(args["hydro"].as<fs::path>().string());
-        double mini_tau0 = med1.get_tauH();
-        std::vector<event> events;
-        // Fill in all events
-        LOG_INFO << "Events initialization, tau0 = " <<  mini_tau0;
-        for (int iBin = 0; iBin < TriggerBin.size()-1; iBin++) {
-            
-            // Initialize a pythia generator for each pT trigger bin
-            PythiaGen pythiagen(args["pythia-setting"].as<fs::path>().string(),
+        std::string hydro_path = args["hydro"].as<fs::path>().string();
+        double mini_tau0 = Medium<2>(hydro_path).get_tauH();
+        bool do_jet = args["jet"].as<bool>();
+        int processid = getpid();
+
+        // The jets of a finished event are found by a pool of analysis
+        // threads while the evolution goes on, each thread has its own jet
+        // finder and the response table is shared read-only. The jets are
+        // kept in the event and the statistics are filled in the order of
+        // the events after each batch, so the floating point sums do not 
+        // depend on the number of threads or on the order in which the 
+        // events finish.
+        int nanalysis = std::max(1, args["analysis-threads"].as<int>());
+        std::vector<std::shared_ptr<JetFinder> > jetfinders;
+        JetStatistics JetSample(Rs, shaperbins, zbins, zpTbins);
+        JetHFCorr jet_HF_corr(shaperbins);
+        if (do_jet){
+            auto response = std::make_shared<MediumResponse>("Gmu");
+            if (need_response_table)
+                response->init(args["response-table"].as<fs::path>().string());
+            else
+                response->load(args["response-table"].as<fs::path>().string());
+            for (int i=0; i<nanalysis; i++)
+                jetfinders.push_back(std::make_shared<JetFinder>(300, 300, 3., response));
+        }
+        double pTtrack = args["pTtrack"].as<double>();
+        // Jet analysis of a finished event with the jet finder of thread
+        // ithread, it only touches the event itself
+        auto analyze = [&](int ithread, event & ie){
+            JetFinder & jetfinder = *jetfinders[ithread];
+            jetfinder.set_sigma(ie.sigma);
+            jetfinder.MakeETower(
+                 0.6, Tf, pTtrack,
+                 ie.plist, ie.clist, 10, false);
+            jetfinder.FindJets(Rs, 10., -.9, .9, false);
+            jetfinder.FindHF(ie.plist);
+            jetfinder.Frag(zbins, zpTbins);
+            jetfinder.LabelFlavor();
+            jetfinder.CalcJetshape(shaperbins);
+            ie.jets = std::move(jetfinder.Jets);
+            ie.HFs = std::move(jetfinder.HFs);
+            std::vector<current>().swap(ie.clist);
+        };
+        // Finish an event: transform back to lab frame and free everything
+        // but the final partons (and the sources of the jet analysis). With
+        // jets, the event is then handed to the analysis threads and is not
+        // touched by the evolution any more.
+        auto finish = [&](event & ie, BoundedQueue<event *> & analysis){
+            ie.partons.dump(ie.plist);
+            ie.partons = ParticleStore();
+            for (auto & p : ie.plist) {
+                p.radlist.clear();
+                p.radlist.shrink_to_fit();
+                p.p = p.p.boost_back(0,0,std::tanh(p.x.x3()));
+            }
+            ie.finished = true;
+            if (do_jet) analysis.push(&ie);
+            else std::vector<current>().swap(ie.clist);
+        };
+
+        // Events are generated, evolved and written out in batches of at 
+        // most batch-size events (all events at once for 0), so that the 
+        // memory only grows with the number of events in flight. Every 
+        // event has to start at the beginning of the hydro history, so the
+        // hydro file is read once per batch: the I/O grows with the number
+        // of batches, and batch-size should be as large as the memory allows.
+        // With batches, batch i writes <pid>-partons-<i>.dat.
+        size_t batch_size = args["batch-size"].as<int>();
+        // With a pT-hat bias, a single weighted generator covers all
+        // trigger bins with the same total number of events
+        double bias_power = args["pthat-bias"].as<double>();
+        std::vector<double> GenBin = TriggerBin;
+        int nevents_per_bin = args["pythia-events"].as<int>();
+        if (bias_power > 0.) {
+            GenBin = {TriggerBin.front(), TriggerBin.back()};
+            nevents_per_bin *= TriggerBin.size()-1;
+        }
+        int iBin = 0;
+        // The hard events of a trigger bin are generated by gen-threads
+        // Pythia instances with seeds derived from the master seed
+        int seed = master_seed(args["seed"].as<int>());
+        int ngen = std::max(1, args["gen-threads"].as<int>());
+        std::shared_ptr<ParallelPythiaGen> pythiagen;
+        // transverse positions are sampled here, in the order of the events
+        std::shared_ptr<TransverPositionSampler> TRENToSampler;
+        if (args["eid"].as<int>() >= 0)
+            TRENToSampler = std::make_shared<TransverPositionSampler>(
                                 args["ic"].as<fs::path>().string(),
-                                TriggerBin[iBin],
-                                TriggerBin[iBin+1],
-                                args["eid"].as<int>(),
-                                Q0
+                                args["eid"].as<int>());
+        // the hard events are read from an event library if one is given
+        std::shared_ptr<EventLibraryReader> library;
+        if (args.count("event-library"))
+            library = std::make_shared<EventLibraryReader>(
+                                args["event-library"].as<fs::path>().string());
+        // the next hard event (at x = y = 0), false if there are no more
+        auto next_hard_event = [&](LibraryEvent & h) -> bool{
+            if (library) {
+                if (!library->next(h)) return false;
+                // as ParallelPythiaGen::next does for a generated event
+                color_count = h.color_tag;
+                return true;
+            }
+            while (iBin+1 < int(GenBin.size())){
+                if (!pythiagen) {
+                    pythiagen = std::make_shared<ParallelPythiaGen>(
+                                args["pythia-setting"].as<fs::path>().string(),
+                                GenBin[iBin],
+                                GenBin[iBin+1],
+                                Q0,
+                                bias_power,
+                                seed + iBin*ngen,
+                                ngen,
+                                nevents_per_bin
                                 );
-            for (int i=0; i<args["pythia-events"].as<int>(); i++){
-                event e1;
-                e1.Q0 = Q0;
-                if (!pythiagen.Generate(e1.plist)) continue;
-                e1.maxPT = pythiagen.maxPT();
-                e1.sigma = pythiagen.sigma_gen()/args["pythia-events"].as<int>();
-                e1.x0 = pythiagen.x0();		
+                }
+                HardEvent g;
+                if (!pythiagen->next(g)) {
+                    pythiagen = nullptr;
+                    iBin ++;
+                    continue;
+                }
+                if (!g.ok) continue;
+                h.plist = std::move(g.plist);
+                h.sigma = g.sigma_gen/nevents_per_bin;
+                h.maxPT = g.maxPT;
+                h.x0 = g.x0;
+                h.color_tag = g.color_tag;
+                return true;
+            }
+            return false;
+        };
+        // Each hard event is transported angular-oversample times, with
+        // independent vertices and azimuthal orientations and 1/K of the
+        // weight. The copies of a hard event always go into the same batch.
+        int noversample = std::max(1, args["angular-oversample"].as<int>());
+        std::mt19937 rotation_gen(seed);
+        std::uniform_real_distribution<double> rotation(-M_PI, M_PI);
+        auto generate = [&](std::vector<event> & events){
+            LibraryEvent h;
+            while ((batch_size==0 || events.size()<batch_size) 
+                   && next_hard_event(h)){
+                auto hard = std::make_shared<const std::vector<particle> >(std::move(h.plist));
+                for (int k=0; k<noversample; k++){
+                    event e1;
+                    e1.Q0 = Q0;
+                    e1.finished = false;
+                    e1.hard = hard;
+                    e1.vertex_x = 0.;
+                    e1.vertex_y = 0.;
+                    if (TRENToSampler) TRENToSampler->SampleXY(e1.vertex_y, e1.vertex_x);
+                    e1.phi = (noversample > 1) ? rotation(rotation_gen) : 0.;
+                    e1.maxPT = h.maxPT;
+                    e1.sigma = h.sigma/noversample;
+                    e1.x0 = h.x0;
+                    events.push_back(std::move(e1));
+                }
+            }
+        };
+        // Fill the parton store of an event from the shared hard event: 
+        // every parton is rotated, placed at the vertex and freestreamed to
+        // the hydro start on its way into the store. The shared partons are
+        // released with the last event that uses them.
+        auto setup = [&](event & e){
+            double c = std::cos(e.phi), s = std::sin(e.phi);
+            bool rotate = (e.phi != 0.);
+            if (rotate) rotate_xy(e.x0, c, s);
+            e.x0 = fourvec{e.x0.t(), e.x0.x()+e.vertex_x, e.x0.y()+e.vertex_y, e.x0.z()};
+            e.partons.assign(*e.hard, [&](particle & p){
+                if (rotate) rotate_particle(p, c, s);
+                place_particle(p, e.vertex_x, e.vertex_y);
                 // freestream form t=0 to tau=tau0
                 // move partciles below tau0 to tau0
-                for (auto & p : e1.plist){
-                        p.Tf = Tf+.001;
-                        if (p.x.x0() >= mini_tau0) continue;
-                        else {
-                            double dtau = std::max(mini_tau0, p.tau0);
-                            p.x.a[0] = dtau;
-                            p.x.a[1] += p.p.x()/p.p.t()*dtau;
-                            p.x.a[2] += p.p.y()/p.p.t()*dtau;
+                p.Tf = Tf+.001;
+                if (p.x.x0() < mini_tau0) {
+                    double dtau = std::max(mini_tau0, p.tau0);
+                    p.x.a[0] = dtau;
+                    p.x.a[1] += p.p.x()/p.p.t()*dtau;
+                    p.x.a[2] += p.p.y()/p.p.t()*dtau;
+                }
+            });
+            e.hard = nullptr;
+        };
+
+        std::vector<event> events;
+        for (int ibatch=0; ; ibatch++) {
+            events.clear();
+            // Fill in the events of this batch
+            LOG_INFO << "Events initialization, tau0 = " <<  mini_tau0;
+            generate(events);
+            if (events.empty()) break;
+            // Initialzie a hydro reader
+            Medium<2> med1(hydro_path);
+            LOG_INFO << "Start evolution of " << events.size() << " hard events";
+            // the queue holds every event of the batch, push never blocks
+            BoundedQueue<event *> analysis(events.size());
+            std::vector<std::thread> analysis_threads;
+            std::vector<std::exception_ptr> analysis_errors(nanalysis);
+            // stop and join the analysis threads also if the evolution throws
+            struct join_guard{
+                BoundedQueue<event *> & queue;
+                std::vector<std::thread> & threads;
+                ~join_guard(){
+                    queue.close();
+                    for (auto & t : threads) if (t.joinable()) t.join();
+                }
+            } guard{analysis, analysis_threads};
+            if (do_jet){
+                for (int i=0; i<nanalysis; i++){
+                    analysis_threads.push_back(std::thread([&, i](){
+                        try{
+                            event * e;
+                            while (analysis.pop(e)) analyze(i, *e);
+                        }
+                        catch (...){
+                            analysis_errors[i] = std::current_exception();
                         }
+                    }));
                 }
-                events.push_back(e1);
             }
-        }
-        
-        LOG_INFO << "Start evolution of " << events.size() << " hard events";
-        while(med1.load_next()) {
-            double current_hydro_clock = med1.get_tauL();
-            double dtau = med1.get_hydro_time_step();
-            LOG_INFO << "Hydro t = " << current_hydro_clock/5.076 << " fm/c";
-            for (auto & ie : events){
-                std::vector<particle> new_plist, pOut_list;
-                for (auto & p : ie.plist){
-//              LOG_INFO << " p.x.x3() " << p.x.x3();//test
-//	            LOG_INFO << " p.p.t() " << p.p.t();//test
-                    if (std::abs(p.x.x3())>6. || p.Tf<Tf){
-                        // skip particles at large space-time rapidity
-                        new_plist.push_back(p);
-                        continue;       
-                    }
-                    if (p.x.x0() > current_hydro_clock+dtau){
+            // partons at large space-time rapidity or frozen out are retired,
+            // partons in the future wait until the hydro clock reaches them
+            for (auto & ie : events) {
+                ie.partons.set_schedule(6., Tf, med1.get_hydro_time_step());
+                setup(ie);
+            }
+            while(med1.load_next()) {
+                double current_hydro_clock = med1.get_tauL();
+                double dtau = med1.get_hydro_time_step();
+                LOG_INFO << "Hydro t = " << current_hydro_clock/5.076 << " fm/c";
+                std::vector<particle> pOut_list;
+                for (auto & ie : events){
+                    if (ie.finished) continue;
+                    auto & S = ie.partons;
+                    S.activate(current_hydro_clock+dtau);
+                    size_t n = S.size();
+                    for (size_t k=0; k<n; k++){
                         // skip particles in the future
-                        new_plist.push_back(p);
-                        continue;
-                    }
-                    else{
+                        if (S.x[k].x0() > current_hydro_clock+dtau) continue;
+                        particle p = S.checkout(k);
                         double DeltaTau = current_hydro_clock + dtau - p.x.x0();
                         fourvec ploss = p.p;
                         double T = 0.0, vx = 0.0, vy = 0.0, vz = 0.0;
                         med1.interpolate(p.x, T, vx, vy, vz);
                         pOut_list.clear();
                         A.update_single_particle(DeltaTau, T, {vx, vy, vz}, p, pOut_list);
-                        for (auto & fp : pOut_list) {
-                            // compute energy momentum loss of hard partons (4T<hard)
-                            ploss = ploss - fp.p;
-                            new_plist.push_back(fp);
-                        }
-                        if (args["jet"].as<bool>()){
-                            current J; 
+                        if (do_jet){
+                            for (auto & fp : pOut_list) {
+                                // compute energy momentum loss of hard partons (4T<hard)
+                                ploss = ploss - fp.p;
+                            }
+                            current J;
                             J.p = ploss;
                             J.etas = p.x.x3();
-                            ie.clist.push_back(J);  
+                            ie.clist.push_back(J);
                         }
+                        // the parton is replaced by the outgoing ones
+                        for (auto & fp : pOut_list) 
+                            S.add(std::move(fp), current_hydro_clock+2*dtau);
                     }
+                    S.compact();
+                    // all partons are retired, the event is done
+                    if (S.size()==0 && S.n_waiting()==0) finish(ie, analysis);
                 }
-                ie.plist = new_plist;
             }
-        }
-        // free some mem and transform back to lab frame
-        for (auto & ie: events) {
-            for (auto & p : ie.plist) {
-                p.radlist.clear();
-                p.p = p.p.boost_back(0,0,std::tanh(p.x.x3()));
+            for (auto & ie : events)
+                if (!ie.finished) finish(ie, analysis);
+            // the remaining events are analyzed before the threads exit
+            analysis.close();
+            for (auto & t : analysis_threads) t.join();
+            for (auto & err : analysis_errors)
+                if (err) std::rethrow_exception(err);
+            if (do_jet){
+                for (auto & ie : events){
+                    JetSample.add_event(ie.jets, ie.sigma, ie.x0);
+                    jet_HF_corr.add_event(ie.jets, ie.HFs, ie.sigma);
+                    std::vector<Fjet>().swap(ie.jets);
+                    std::vector<particle>().swap(ie.HFs);
+                }
             }
-            //ie.hlist = ie.plist;
-        }
-        int processid = getpid();
-        
-        std::stringstream fheader;
-        fheader << args["output"].as<fs::path>().string() << "/" << processid << "-partons.dat";
-        std::ofstream f(fheader.str());
-	    std::vector<particle> plist;
-        for (int i=0; i<events.size(); i++){
-            auto & ie = events[i];
-            for (auto & it : ie.plist) {
-                it.weight=ie.sigma;
-                plist.push_back(it);
+            
+            std::stringstream fheader;
+            fheader << args["output"].as<fs::path>().string() << "/" << processid << "-partons";
+            if (batch_size > 0) fheader << "-" << ibatch;
+            fheader << ".dat";
+            std::vector<particle> plist;
+            for (size_t i=0; i<events.size(); i++){
+                auto & ie = events[i];
+                for (auto & it : ie.plist) {
+                    it.weight=ie.sigma;
+                    plist.push_back(std::move(it));
+                }
+                std::vector<particle>().swap(ie.plist);
             }
+            output_oscar( plist ,4, fheader.str());
+    //	    output_oscar( plist , fheader.str());
+        }
+
+        if (do_jet){
+            std::stringstream jheader;
+            jheader << args["output"].as<fs::path>().string()
+                    << "/" << processid;
+            JetSample.write(jheader.str());
+            jet_HF_corr.write(jheader.str());
         }
-        output_oscar( plist ,4, fheader.str());
-//	    output_oscar( plist , fheader.str());
     }
     
     catch (const po::required_option& e){
@@ -9,12 +9,15 @@
 #include <boost/filesystem/fstream.hpp>
 #include <boost/program_options.hpp>
 #include <sstream>
+#include <memory>
 #include <unistd.h>
 
 #include "simpleLogger.h"
 #include "Medium_Reader.h"
 #include "lido.h"
 #include "pythia_jet_gen.h"
+#include "parallel_pythia.h"
+#include "event_library.h"
 #include "Hadronize.h"
 #include "jet_finding.h"
 
@@ -43,7 +46,11 @@ int main(int argc, char* argv[]){
     ("output,o", po::value<fs::path>()->value_name("PATH")->default_value("./"), "output file prefix or folder")
     ("jet", po::bool_switch(), "Turn on to do jet finding (takes time)")
     ("pTtrack", po::value<double>()->value_name("DOUBLE")->default_value(.7,".7"),"minimum pT track in the jet shape reconstruction")
-    ("Q0,q",po::value<double>()->value_name("DOUBLE")->default_value(.5,".5"),"Scale [GeV] to insert in-medium transport");
+    ("Q0,q",po::value<double>()->value_name("DOUBLE")->default_value(.5,".5"),"Scale [GeV] to insert in-medium transport")
+    ("pthat-bias", po::value<double>()->value_name("DOUBLE")->default_value(0.,"0"),"sample all trigger bins with one Pythia generator biased by pThat^power, 0 for one generator per bin")
+    ("gen-threads", po::value<int>()->value_name("INT")->default_value(1,"1"),"number of threads (Pythia instances) for the hard event generation")
+    ("seed", po::value<int>()->value_name("INT")->default_value(-1,"-1"),"master random seed of the event generation, <0 for the process id")
+    ("write-events", po::value<fs::path>()->value_name("PATH"),"also write the hard events (before the vertex sampling) to an event library");
     
     po::variables_map args{};
     try{
@@ -112,24 +119,56 @@ int main(int argc, char* argv[]){
         std::vector<event> events;
         // Fill in all events
         double Q0 = args["Q0"].as<double>();
-        for (int iBin = 0; iBin < TriggerBin.size()-1; iBin++) {
-            // Initialize a pythia generator for each pT trigger bin
-            PythiaGen pythiagen(
+        // With a pT-hat bias, a single weighted generator covers all
+        // trigger bins with the same total number of events
+        double bias_power = args["pthat-bias"].as<double>();
+        std::vector<double> GenBin = TriggerBin;
+        int nevents_per_bin = args["pythia-events"].as<int>();
+        if (bias_power > 0.) {
+            GenBin = {TriggerBin.front(), TriggerBin.back()};
+            nevents_per_bin *= TriggerBin.size()-1;
+        }
+        // The hard events of a trigger bin are generated by gen-threads
+        // Pythia instances with seeds derived from the master seed
+        int seed = master_seed(args["seed"].as<int>());
+        int ngen = std::max(1, args["gen-threads"].as<int>());
+        // transverse positions are sampled here, in the order of the events
+        std::shared_ptr<TransverPositionSampler> TRENToSampler;
+        if (args["eid"].as<int>() >= 0)
+            TRENToSampler = std::make_shared<TransverPositionSampler>(
+                                args["ic"].as<fs::path>().string(),
+                                args["eid"].as<int>());
+        std::shared_ptr<EventLibraryWriter> library;
+        if (args.count("write-events"))
+            library = std::make_shared<EventLibraryWriter>(
+                                args["write-events"].as<fs::path>().string());
+        for (int iBin = 0; iBin+1 < int(GenBin.size()); iBin++) {
+            // Initialize the pythia generators for each pT trigger bin
+            ParallelPythiaGen pythiagen(
                 args["pythia-setting"].as<fs::path>().string(),
-                args["ic"].as<fs::path>().string(),
-                TriggerBin[iBin],
-                TriggerBin[iBin+1],
-                args["eid"].as<int>(),
-                Q0
+                GenBin[iBin],
+                GenBin[iBin+1],
+                Q0,
+                bias_power,
+                seed + iBin*ngen,
+                ngen,
+                nevents_per_bin
                                 );
-            for (int i=0; i<args["pythia-events"].as<int>(); i++){
+            HardEvent h;
+            while (pythiagen.next(h)){
+                if (!h.ok) continue;
+                if (library) 
+                    library->write(h.plist, h.sigma_gen/nevents_per_bin, h.maxPT, h.x0, h.color_tag);
+                double x = 0., y = 0.;
+                if (TRENToSampler) TRENToSampler->SampleXY(y, x);
+                place_event(h.plist, x, y);
                 event e1;
                 e1.Q0 = Q0;
-                if (!pythiagen.Generate(e1.plist)) continue;
-                e1.maxPT = pythiagen.maxPT();
-                e1.sigma = pythiagen.sigma_gen()/args["pythia-events"].as<int>();
-                e1.x0 = pythiagen.x0();		
-                events.push_back(e1);
+                e1.plist = std::move(h.plist);
+                e1.maxPT = h.maxPT;
+                e1.sigma = h.sigma_gen/nevents_per_bin;
+                e1.x0 = fourvec{h.x0.t(), h.x0.x()+x, h.x0.y()+y, h.x0.z()};
+                events.push_back(std::move(e1));
             }
             
         }
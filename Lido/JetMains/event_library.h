@@ -0,0 +1,174 @@
+#ifndef EVENT_LIBRARY_H
+#define EVENT_LIBRARY_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include "predefine.h"
+
+// Binary library of vacuum (Pythia) hard events, so that the showers can
+// be generated once and reused by many transport runs.
+// File layout: an 8 byte magic followed by chunks. A chunk starts with the
+// number of events and the number of payload bytes (uint64 each), the
+// payload holds the events one after the other:
+//   sigma, maxPT, vertex x0[4] (double), first free color tag (int32),
+//   number of partons (uint64),
+// and for each parton
+//   pid, col, acol (int32), charged (uint8),
+//   mass, x0[4], p0[4], tau0, Q0 (double).
+// Everything else of a parton is in its initial state when it is read.
+// color_tag is the first free color tag after the partons of the event,
+// the reader of an event sets color_count to it before the transport
+struct LibraryEvent{
+    std::vector<particle> plist;
+    double sigma, maxPT;
+    fourvec x0;
+    int color_tag;
+};
+
+namespace event_library{
+    static const char magic[8] = {'L','I','D','O','E','V','T','2'};
+    // bytes of an event without its partons and of one parton
+    static const size_t event_bytes = 6*sizeof(double)+sizeof(int32_t)
+                                    + sizeof(uint64_t);
+    static const size_t parton_bytes = 3*sizeof(int32_t)+sizeof(uint8_t)
+                                     + 11*sizeof(double);
+}
+
+class EventLibraryWriter{
+public:
+    // events are collected and written in chunks of chunk_size events
+    EventLibraryWriter(std::string fname, size_t _chunk_size=1000):
+    f(fname, std::ios::binary), chunk_size(_chunk_size>0 ? _chunk_size : 1), nevents(0){
+        if (!f) throw std::runtime_error("cannot write "+fname);
+        f.write(event_library::magic, 8);
+    }
+    ~EventLibraryWriter(){
+        flush();
+    }
+    void write(const std::vector<particle> & plist, double sigma, double maxPT,
+               const fourvec & x0, int color_tag){
+        put(sigma);
+        put(maxPT);
+        for (int i=0; i<4; i++) put(x0.a[i]);
+        put(int32_t(color_tag));
+        put(uint64_t(plist.size()));
+        for (auto & p : plist){
+            put(int32_t(p.pid));
+            put(int32_t(p.col));
+            put(int32_t(p.acol));
+            put(uint8_t(p.charged ? 1 : 0));
+            put(p.mass);
+            for (int i=0; i<4; i++) put(p.x0.a[i]);
+            for (int i=0; i<4; i++) put(p.p0.a[i]);
+            put(p.tau0);
+            put(p.Q0);
+        }
+        nevents ++;
+        if (nevents == chunk_size) flush();
+    }
+    void flush(void){
+        if (nevents == 0) return;
+        uint64_t head[2] = {nevents, buffer.size()};
+        f.write(reinterpret_cast<const char *>(head), sizeof(head));
+        f.write(buffer.data(), buffer.size());
+        f.flush();
+        buffer.clear();
+        nevents = 0;
+    }
+private:
+    template<typename T>
+    void put(T v){
+        const char * c = reinterpret_cast<const char *>(&v);
+        buffer.insert(buffer.end(), c, c+sizeof(T));
+    }
+    std::ofstream f;
+    const size_t chunk_size;
+    uint64_t nevents;
+    std::vector<char> buffer;
+};
+
+class EventLibraryReader{
+public:
+    EventLibraryReader(std::string fname):
+    f(fname, std::ios::binary), name(fname), nleft(0), pos(0){
+        char m[8];
+        if (!f.read(m, 8) || std::memcmp(m, event_library::magic, 7) != 0)
+            throw std::runtime_error(fname+" is not an event library");
+        if (m[7] != event_library::magic[7])
+            throw std::runtime_error(fname+" is an event library of another version, write it again");
+        f.seekg(0, std::ios::end);
+        fsize = f.tellg();
+        f.seekg(8, std::ios::beg);
+    }
+    // the next event, false at the end of the library
+    bool next(LibraryEvent & e){
+        if (nleft == 0 && !read_chunk()) return false;
+        e.sigma = get<double>();
+        e.maxPT = get<double>();
+        for (int i=0; i<4; i++) e.x0.a[i] = get<double>();
+        e.color_tag = get<int32_t>();
+        uint64_t n = get<uint64_t>();
+        // the partons have to fit into the rest of the chunk
+        if (n > (buffer.size()-pos)/event_library::parton_bytes)
+            throw std::runtime_error(name+" is corrupted: an event has more partons than its chunk holds");
+        e.plist.resize(n);
+        for (auto & p : e.plist){
+            p.pid = get<int32_t>();
+            p.col = get<int32_t>();
+            p.acol = get<int32_t>();
+            p.charged = (get<uint8_t>() != 0);
+            p.mass = get<double>();
+            for (int i=0; i<4; i++) p.x0.a[i] = get<double>();
+            for (int i=0; i<4; i++) p.p0.a[i] = get<double>();
+            p.tau0 = get<double>();
+            p.Q0 = get<double>();
+            p.Q00 = p.Q0;
+            p.x = p.x0;
+            p.p = p.p0;
+            p.is_virtual = false;
+            p.T0 = -100;
+            p.mfp0 = 0.;
+            p.vcell.assign(3, 0.);
+            p.radlist.clear();
+        }
+        nleft --;
+        return true;
+    }
+private:
+    bool read_chunk(void){
+        uint64_t head[2];
+        if (!f.read(reinterpret_cast<char *>(head), sizeof(head))) return false;
+        // check the sizes in the chunk header before allocating anything
+        uint64_t left = fsize - uint64_t(f.tellg());
+        if (head[1] > left)
+            throw std::runtime_error(name+" is truncated: a chunk is larger than the rest of the file");
+        if (head[0] > head[1]/event_library::event_bytes)
+            throw std::runtime_error(name+" is corrupted: a chunk has more events than its size holds");
+        buffer.resize(head[1]);
+        if (!f.read(buffer.data(), head[1]))
+            throw std::runtime_error(name+" is truncated");
+        nleft = head[0];
+        pos = 0;
+        return nleft > 0;
+    }
+    template<typename T>
+    T get(void){
+        if (pos+sizeof(T) > buffer.size())
+            throw std::runtime_error(name+" is corrupted");
+        T v;
+        std::memcpy(&v, buffer.data()+pos, sizeof(T));
+        pos += sizeof(T);
+        return v;
+    }
+    std::ifstream f;
+    std::string name;
+    uint64_t fsize, nleft;
+    size_t pos;
+    std::vector<char> buffer;
+};
+
+#endif
@@ -17,6 +17,7 @@
 #include "pythia_jet_gen.h"
 #include "Hadronize.h"
 #include "jet_finding.h"
+#include "particle_store.h"
 
 namespace po = boost::program_options;
 namespace fs = boost::filesystem;
@@ -45,6 +46,7 @@ void output_jet(std::ofstream &  f, double weight, std::vector<particle> plist){
 }
 struct event{
 std::vector<particle> plist, thermal_list, hlist;
+ParticleStore partons;
 std::vector<current> clist;
 double sigma, Q0, maxPT;
 fourvec x0;
@@ -301,73 +303,59 @@ int main(int argc, char* argv[]){
         }
         e1.Q0 = 1.0;
         e1.sigma =1.0; //added by yufu
-        events.push_back(e1);
+        events.push_back(std::move(e1));
 //	std::cout << " check--p.p.t " << e1.plist[0].p.t() << std::endl;
 //	std::cout << " check--p.p.x " << e1.plist[0].p.x() << std::endl;
                 
 
         LOG_INFO << "Start evolution of " << events.size() << " hard events";
+        // partons at large space-time rapidity or frozen out are retired,
+        // partons in the future wait until the hydro clock reaches them
+        for (auto & ie : events) {
+            ie.partons.set_schedule(6., Tf, med1.get_hydro_time_step());
+            ie.partons.assign(ie.plist);
+        }
         while(med1.load_next()) {
             double current_hydro_clock = med1.get_tauL();
             double dtau = med1.get_hydro_time_step();
             LOG_INFO << "Hydro t = " 
                      << current_hydro_clock/5.076 << " fm/c";
+            std::vector<particle> pOut_list;
             for (auto & ie : events){
-                std::vector<particle> new_plist, pOut_list;
-//		LOG_INFO << "test-1";
-                for (auto & p : ie.plist){
-//		   LOG_INFO << "test-2";
-  //                 LOG_INFO << " p.x.x3() " << p.x.x3();//test	
-//	           LOG_INFO << " p.p.t() " << p.p.t();//test	   
-                    if ( std::abs(p.x.x3())>6. || p.Tf<Tf){
-                        // skip particles at large space-time rapidity
-                        new_plist.push_back(p);
-                        continue;
-//		        LOG_INFO << "test-3";	
-                    }
-  //                  LOG_INFO << p.x.x0();//test	
-  //                  LOG_INFO << current_hydro_clock+dtau;//test
-		    if (p.x.x0() > current_hydro_clock+dtau){
-                        // skip particles in the future
-                        new_plist.push_back(p);
-                        continue;
-//			LOG_INFO << "test-4";
+                auto & S = ie.partons;
+                S.activate(current_hydro_clock+dtau);
+                size_t n = S.size();
+                for (size_t k=0; k<n; k++){
+                    // skip particles in the future
+                    if (S.x[k].x0() > current_hydro_clock+dtau) continue;
+                    particle p = S.checkout(k);
+                    double DeltaTau = current_hydro_clock 
+                                    + dtau - p.x.x0();
+                    fourvec ploss = p.p;
+                    double T = 0.0, vx = 0.0, vy = 0.0, vz = 0.0;
+                    med1.interpolate(p.x, T, vx, vy, vz);
+                    pOut_list.clear();
+                    A.update_single_particle(DeltaTau, 
+                                             T, {vx, vy, vz}, 
+                                             p, pOut_list
+                                             );  
+                    for (auto & fp : pOut_list) {
+                        // compute energy momentum loss of hard partons (4T<hard)
+                        ploss = ploss - fp.p;
                     }
-                    else{
-                        double DeltaTau = current_hydro_clock 
-                                        + dtau - p.x.x0();
-//			LOG_INFO << DeltaTau;//test
-                        fourvec ploss = p.p;
-//			LOG_INFO << " p.p.t=" << p.p.t() << " p.p.x=" << p.p.x() << " p.p.y=" << p.p.y() << " p.p.z=" << p.p.z() ;//test
-                        double T = 0.0, vx = 0.0, vy = 0.0, vz = 0.0;
-//			LOG_INFO << " T=0.0  " <<  T << " vx=0.0 " << vx << " vy=0.0 " << vy << " vz=0.0 " << vz << std::endl;//test
-                        med1.interpolate(p.x, T, vx, vy, vz);
-//			LOG_INFO << " T= " <<  T << " vx=" << vx << " vy=" << vy << " vz=" << vz << std::endl;//test
-                        pOut_list.clear();
-//			LOG_INFO << "T-- " << T;//test
-                        A.update_single_particle(DeltaTau, 
-                                                 T, {vx, vy, vz}, 
-                                                 p, pOut_list
-                                                 );  
-//                        LOG_INFO << "T " << T;//test
-			for (auto & fp : pOut_list) {
-                            // compute energy momentum loss of hard partons (4T<hard)
-                            ploss = ploss - fp.p;
-                            new_plist.push_back(fp);
-                        }
-                        if (args["jet"].as<bool>()){
-                            current J; 
-                            J.p = ploss;
-                            J.etas = p.x.x3();
-                            ie.clist.push_back(J);  
-                        }
-//			LOG_INFO << "test-5";
+                    if (args["jet"].as<bool>()){
+                        current J; 
+                        J.p = ploss;
+                        J.etas = p.x.x3();
+                        ie.clist.push_back(J);  
                     }
+                    for (auto & fp : pOut_list) 
+                        S.add(std::move(fp), current_hydro_clock+2*dtau);
                 }
-                ie.plist = new_plist;
-//		LOG_INFO << "test-6";
-	    }
+                S.compact();
+            }
         }
+        for (auto & ie : events) ie.partons.dump(ie.plist);
         // free some mem and transform back to lab frame
 	for (auto & ie: events) {
             for (auto & p : ie.plist) { 
@@ -0,0 +1,162 @@
+#ifndef PARALLEL_PYTHIA_H
+#define PARALLEL_PYTHIA_H
+
+#include <vector>
+#include <cmath>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <unistd.h>
+#include "pythia_jet_gen.h"
+
+// A fixed-capacity FIFO between one producer and one consumer thread.
+// push() blocks while the queue is full and pop() while it is empty,
+// after close() both return false instead of blocking.
+template<typename T>
+class BoundedQueue{
+public:
+    BoundedQueue(size_t _capacity): capacity(_capacity>0 ? _capacity : 1), closed(false) {}
+    bool push(T item){
+        std::unique_lock<std::mutex> lock(mtx);
+        not_full.wait(lock, [this]{return closed || items.size()<capacity;});
+        if (closed) return false;
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+        return true;
+    }
+    bool pop(T & item){
+        std::unique_lock<std::mutex> lock(mtx);
+        not_empty.wait(lock, [this]{return closed || !items.empty();});
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+    void close(void){
+        std::lock_guard<std::mutex> lock(mtx);
+        closed = true;
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
+private:
+    const size_t capacity;
+    bool closed;
+    std::deque<T> items;
+    std::mutex mtx;
+    std::condition_variable not_full, not_empty;
+};
+
+// A hard event as produced by PythiaGen, "ok" is false if Generate failed.
+// color_tag is the first free color tag after the event, error holds an
+// exception thrown by the generator.
+struct HardEvent{
+    std::vector<particle> plist;
+    double maxPT, sigma_gen;
+    fourvec x0;
+    int color_tag;
+    bool ok;
+    std::exception_ptr error;
+};
+
+// Generate nevents hard events in one pT-hat range with nworkers threads.
+// Worker w owns a PythiaGen seeded with seed+w and produces the events
+// w, w+nworkers, w+2*nworkers, ... into its own bounded queue; next()
+// takes the events from the queues in turn. For a given seed and number
+// of workers the sequence of events is therefore reproducible.
+// The partons are produced at x = y = 0, the transverse position is left
+// to the caller (see place_event), since the position sampler draws from
+// the shared random engine of the library. For the same reason the global
+// color_count is only set by next(), in the consumer thread. An exception
+// in a worker is passed through its queue and rethrown by next().
+class ParallelPythiaGen{
+public:
+    ParallelPythiaGen(std::string f_pythia, double pTHL, double pTHH, double Q0,
+                      double bias_power, int seed, int nworkers, int _nevents,
+                      size_t capacity=16):
+    nevents(_nevents), inext(0){
+        nworkers = std::max(1, nworkers);
+        for (int w=0; w<nworkers; w++)
+            queues.push_back(std::make_shared<BoundedQueue<HardEvent> >(capacity));
+        for (int w=0; w<nworkers; w++){
+            threads.push_back(std::thread([=](){
+                try{
+                    PythiaGen gen(f_pythia, "", pTHL, pTHH, -1, Q0, bias_power, seed+w);
+                    for (int i=w; i<nevents; i+=nworkers){
+                        HardEvent e;
+                        e.ok = gen.Generate(e.plist);
+                        e.maxPT = gen.maxPT();
+                        e.sigma_gen = gen.sigma_gen();
+                        e.x0 = gen.x0();
+                        e.color_tag = gen.color_tag();
+                        if (!queues[w]->push(std::move(e))) break;
+                    }
+                }
+                catch (...){
+                    HardEvent e;
+                    e.ok = false;
+                    e.error = std::current_exception();
+                    queues[w]->push(std::move(e));
+                }
+            }));
+        }
+    }
+    ~ParallelPythiaGen(){
+        for (auto & q : queues) q->close();
+        for (auto & t : threads) t.join();
+    }
+    // the next event in order, false once all events are taken
+    bool next(HardEvent & e){
+        if (inext >= nevents) return false;
+        bool ok = queues[inext%queues.size()]->pop(e);
+        inext ++;
+        if (!ok) return false;
+        if (e.error) std::rethrow_exception(e.error);
+        color_count = e.color_tag;
+        return true;
+    }
+private:
+    const int nevents;
+    int inext;
+    std::vector<std::shared_ptr<BoundedQueue<HardEvent> > > queues;
+    std::vector<std::thread> threads;
+};
+
+// master seed of a run, the process id if none (seed < 0) is given
+int master_seed(int seed){
+    return seed >= 0 ? seed : int(getpid());
+}
+
+// move a parton produced at x = y = 0 to (x, y)
+void place_particle(particle & p, double x, double y){
+    p.x0.a[1] += x;
+    p.x0.a[2] += y;
+    p.x.a[1] += x;
+    p.x.a[2] += y;
+}
+
+// move the partons of an event produced at x = y = 0 to (x, y)
+void place_event(std::vector<particle> & plist, double x, double y){
+    for (auto & p : plist) place_particle(p, x, y);
+}
+
+// rotate the transverse components of v by the angle with cosine c and sine s
+template<typename V>
+void rotate_xy(V & v, double c, double s){
+    double vx = v.a[1], vy = v.a[2];
+    v.a[1] = c*vx - s*vy;
+    v.a[2] = s*vx + c*vy;
+}
+
+// rotate a parton around the beam axis by the angle with cosine c and sine s
+void rotate_particle(particle & p, double c, double s){
+    rotate_xy(p.x0, c, s);
+    rotate_xy(p.x, c, s);
+    rotate_xy(p.p0, c, s);
+    rotate_xy(p.p, c, s);
+}
+
+#endif
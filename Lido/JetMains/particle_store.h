@@ -0,0 +1,223 @@
+#ifndef PARTICLE_STORE_H
+#define PARTICLE_STORE_H
+
+#include <vector>
+#include <map>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include "predefine.h"
+
+// Structure-of-arrays storage for the partons of an event.
+// The fields read for every parton at every hydro step (x, p, pid, T0, Tf,
+// tau0) are kept in contiguous columns, so that the evolution loop can skip
+// partons in the future or frozen-out partons without touching (or copying)
+// the full particle. The remaining, rarely touched fields, e.g. radlist and
+// colors, are kept in the side array "cold", and a particle is only put
+// together from both when it is checked out. Slots are compacted in place.
+//
+// Only the active partons live in the columns. Partons whose x0 lies
+// beyond the current horizon wait in a queue bucketed in x0, and partons
+// that are frozen out (Tf < Tf_cut) or outside of |etas| < etas_max are
+// retired for good, so a hydro step only touches partons that need an
+// update.
+class ParticleStore{
+public:
+    ParticleStore():
+        etas_max(std::numeric_limits<double>::max()),
+        Tf_cut(-std::numeric_limits<double>::max()),
+        bucket_width(1.), nwait(0) {}
+    // cuts for retired partons and width (in x0) of the waiting buckets
+    void set_schedule(double _etas_max, double _Tf_cut, double _width){
+        etas_max = _etas_max;
+        Tf_cut = _Tf_cut;
+        bucket_width = _width > 0. ? _width : 1.;
+    }
+    size_t size(void) const {return pid.size();}
+    size_t n_waiting(void) const {return nwait;}
+    size_t n_retired(void) const {return retired.size();}
+    // retire the parton, queue it if x0 > horizon, else make it active
+    void add(particle q, double horizon){
+        if (std::abs(q.x.x3())>etas_max || q.Tf<Tf_cut) {
+            retired.push_back(std::move(q));
+        }
+        else if (q.x.x0() > horizon) {
+            waiting[bucket(q.x.x0())].push_back(std::move(q));
+            nwait ++;
+        }
+        else push_back(std::move(q));
+    }
+    // make all waiting partons with x0 <= horizon active
+    void activate(double horizon){
+        long last = bucket(horizon);
+        while (!waiting.empty() && waiting.begin()->first <= last){
+            auto it = waiting.begin();
+            std::vector<particle> & B = it->second;
+            if (it->first < last) {
+                for (auto & q : B) push_back(std::move(q));
+                nwait -= B.size();
+                waiting.erase(it);
+                continue;
+            }
+            // the last bucket straddles the horizon
+            size_t j = 0;
+            for (size_t i=0; i<B.size(); i++){
+                if (B[i].x.x0() > horizon) {
+                    if (i != j) B[j] = std::move(B[i]);
+                    j++;
+                }
+                else push_back(std::move(B[i]));
+            }
+            nwait -= B.size()-j;
+            B.resize(j);
+            if (j==0) waiting.erase(it);
+            break;
+        }
+    }
+    // append a parton
+    void push_back(particle q){
+        x.push_back(q.x);
+        p.push_back(q.p);
+        pid.push_back(q.pid);
+        T0.push_back(q.T0);
+        Tf.push_back(q.Tf);
+        tau0.push_back(q.tau0);
+        alive.push_back(1);
+        cold_state c;
+        c.col = q.col;
+        c.acol = q.acol;
+        c.charged = q.charged;
+        c.is_virtual = q.is_virtual;
+        c.mass = q.mass;
+        c.weight = q.weight;
+        c.Q0 = q.Q0;
+        c.Q00 = q.Q00;
+        c.mfp0 = q.mfp0;
+        c.x0 = q.x0;
+        c.p0 = q.p0;
+        c.mother_p = q.mother_p;
+        c.radlist = std::move(q.radlist);
+        c.vcell = std::move(q.vcell);
+        cold.push_back(std::move(c));
+    }
+    // move the parton in slot i out of the store, the slot is removed by
+    // the next compact()
+    particle checkout(size_t i){
+        particle q;
+        q.x = x[i];
+        q.p = p[i];
+        q.pid = pid[i];
+        q.T0 = T0[i];
+        q.Tf = Tf[i];
+        q.tau0 = tau0[i];
+        cold_state & c = cold[i];
+        q.col = c.col;
+        q.acol = c.acol;
+        q.charged = c.charged;
+        q.is_virtual = c.is_virtual;
+        q.mass = c.mass;
+        q.weight = c.weight;
+        q.Q0 = c.Q0;
+        q.Q00 = c.Q00;
+        q.mfp0 = c.mfp0;
+        q.x0 = c.x0;
+        q.p0 = c.p0;
+        q.mother_p = c.mother_p;
+        q.radlist = std::move(c.radlist);
+        q.vcell = std::move(c.vcell);
+        alive[i] = 0;
+        return q;
+    }
+    // remove checked out slots, the remaining partons keep their order
+    void compact(void){
+        size_t j = 0;
+        for (size_t i=0; i<size(); i++){
+            if (!alive[i]) continue;
+            if (i != j) {
+                x[j] = x[i];
+                p[j] = p[i];
+                pid[j] = pid[i];
+                T0[j] = T0[i];
+                Tf[j] = Tf[i];
+                tau0[j] = tau0[i];
+                alive[j] = 1;
+                cold[j] = std::move(cold[i]);
+            }
+            j++;
+        }
+        resize(j);
+    }
+    void clear(void){
+        resize(0);
+        waiting.clear();
+        retired.clear();
+        nwait = 0;
+    }
+    // move a particle list into the store, all partons start out waiting
+    // (or retired) until the first call of activate()
+    void assign(std::vector<particle> & plist){
+        clear();
+        for (auto & q : plist) 
+            add(std::move(q), -std::numeric_limits<double>::max());
+        plist.clear();
+    }
+    // fill the store from a particle list that is left untouched, e.g.
+    // the partons of a hard event shared by several events; prepare(q) is
+    // applied to each parton on its way into the columns, so that no
+    // prepared copy of the whole list is ever made
+    template<typename F>
+    void assign(const std::vector<particle> & plist, F prepare){
+        clear();
+        for (auto & q0 : plist){
+            particle q(q0);
+            prepare(q);
+            add(std::move(q), -std::numeric_limits<double>::max());
+        }
+    }
+    // move all partons (active, waiting and retired) out of the store
+    void dump(std::vector<particle> & plist){
+        plist.clear();
+        plist.reserve(size()+nwait+retired.size());
+        for (size_t i=0; i<size(); i++) plist.push_back(checkout(i));
+        for (auto & B : waiting)
+            for (auto & q : B.second) plist.push_back(std::move(q));
+        for (auto & q : retired) plist.push_back(std::move(q));
+        clear();
+    }
+    std::vector<coordinate> x;
+    std::vector<fourvec> p;
+    std::vector<int> pid;
+    std::vector<double> T0, Tf, tau0;
+private:
+    // the fields of a particle that are not in the columns
+    struct cold_state{
+        int col, acol;
+        bool charged, is_virtual;
+        double mass, weight, Q0, Q00, mfp0;
+        coordinate x0;
+        fourvec p0, mother_p;
+        std::vector<std::vector<particle> > radlist;
+        std::vector<double> vcell;
+    };
+    long bucket(double x0) const {
+        return long(std::floor(x0/bucket_width));
+    }
+    void resize(size_t n){
+        x.resize(n);
+        p.resize(n);
+        pid.resize(n);
+        T0.resize(n);
+        Tf.resize(n);
+        tau0.resize(n);
+        alive.resize(n);
+        cold.resize(n);
+    }
+    std::vector<char> alive;
+    std::vector<cold_state> cold;
+    double etas_max, Tf_cut, bucket_width;
+    std::map<long, std::vector<particle> > waiting;
+    size_t nwait;
+    std::vector<particle> retired;
+};
+
+#endif
@@ -17,7 +17,12 @@ double Tpp(double b){
 
 class PythiaGen{
 public:
-    PythiaGen(std::string f_pythia, std::string f_trento, double pTHL, double pTHH, int iev, double _Q0);
+    // With bias_power > 0, hard processes are sampled with a weight
+    // (pTHat/pTHL)^bias_power and sigma_gen() carries the inverse weight,
+    // so that a single generator can cover a wide pT-hat range.
+    // seed < 0 seeds Pythia with the process id
+    PythiaGen(std::string f_pythia, std::string f_trento, double pTHL, double pTHH, int iev, double _Q0,
+              double bias_power=0., int seed=-1);
     bool Generate(std::vector<particle> & plist);
     double sigma_gen(void){
         return sigma0;
@@ -28,57 +33,74 @@ public:
     fourvec x0(void){
 	return _x0;
     }
+    // first free color tag after the last event
+    int color_tag(void){
+        return _color_tag;
+    }
 private:
     Pythia pythia;
     TransverPositionSampler *TRENToSampler;
     double sigma0, Q0;
     fourvec _x0;
-    int _iev;
+    int _iev, _color_tag;
 };
 
-void reference_pmu(int i, double & tau, Event & event){
-    auto p = event[i];
-    int absid = p.idAbs();
-    int im1 = p.mother1();
-    int im2 = p.mother2();
-    if (im1==im2 && im2 > 0){
-        // simply recoil effect, go on
-        reference_pmu(im1, tau, event);
-    }
-    if (im1==0 && im2 ==0) {
-	return;
-    }
-    if (im1>0 && im2==0){
-	    // radiation
-        auto P = event[im1];
-        auto k = event[P.daughter1()];
-        auto q = event[P.daughter2()];
-        fourvec Pmu{P.e(), P.px(), P.py(), P.pz()};
-        fourvec kmu{k.e(), k.px(), k.py(), k.pz()};
-        fourvec qmu{q.e(), q.px(), q.py(), q.pz()};
-        double xk = kmu.t()/(kmu.t()+qmu.t());
-        double xq = 1.-xk;
-        double Mk2 = k.m()*k.m();
-        double Mq2 = q.m()*q.m();
-        double MP2 = P.m()*P.m();
-        double kT2 = measure_perp(kmu+qmu, kmu).pabs2();
-        double tauf = 2*xq*xk*(kmu.t()+qmu.t())/(kT2 + xq*Mk2 + xk*Mq2 - xk*xq*MP2);
-        if (p.e() > 0.5*(kmu.t()+qmu.t())){
-            reference_pmu(im1, tau, event);
+// Formation time (lab frame) of every entry of the event record, tau[i].
+// An entry copied from a single mother (recoil) inherits the time of the
+// mother, a radiated entry adds the formation time of its splitting unless
+// it is the harder daughter, and entries with two mothers or none start at
+// zero. The cumulative time is memoized along the mother chains, so the
+// whole record is processed in one pass.
+void formation_times(Event & event, std::vector<double> & tau){
+    int n = event.size();
+    tau.assign(n, 0.);
+    std::vector<char> done(n, 0);
+    // single mother of each entry on the chain, -1 if there is none
+    std::vector<int> chain, parent;
+    for (int i=0; i<n; i++){
+        chain.clear();
+        parent.clear();
+        int j = i;
+        while (j >= 0 && !done[j]){
+            int im1 = event[j].mother1();
+            int im2 = event[j].mother2();
+            chain.push_back(j);
+            j = (im1>0 && (im2==0 || im2==im1)) ? im1 : -1;
+            parent.push_back(j);
         }
-        else {
-            tau += tauf;
-            reference_pmu(im1, tau, event);
+        // the chain ends at a finished entry or at one without single mother
+        for (int c=int(chain.size())-1; c>=0; c--){
+            int k = chain[c];
+            auto p = event[k];
+            double t = (parent[c] >= 0) ? tau[parent[c]] : 0.;
+            if (p.mother1()>0 && p.mother2()==0){
+                // radiation
+                auto P = event[p.mother1()];
+                auto kk = event[P.daughter1()];
+                auto q = event[P.daughter2()];
+                fourvec kmu{kk.e(), kk.px(), kk.py(), kk.pz()};
+                fourvec qmu{q.e(), q.px(), q.py(), q.pz()};
+                if (p.e() <= 0.5*(kmu.t()+qmu.t())){
+                    double xk = kmu.t()/(kmu.t()+qmu.t());
+                    double xq = 1.-xk;
+                    double Mk2 = kk.m()*kk.m();
+                    double Mq2 = q.m()*q.m();
+                    double MP2 = P.m()*P.m();
+                    double kT2 = measure_perp(kmu+qmu, kmu).pabs2();
+                    t += 2*xq*xk*(kmu.t()+qmu.t())/(kT2 + xq*Mk2 + xk*Mq2 - xk*xq*MP2);
+                }
+            }
+            tau[k] = t;
+            done[k] = 1;
         }
     }
-    if (im1 != im2 && im1 > 0 && im2 > 0){
-        return;
-    }
 }
 
-PythiaGen::PythiaGen(std::string f_pythia, std::string f_trento,double pTHL, double pTHH, int iev, double _Q0)
+PythiaGen::PythiaGen(std::string f_pythia, std::string f_trento,double pTHL, double pTHH, int iev, double _Q0,
+                     double bias_power, int seed)
 {
     _iev = iev;
+    TRENToSampler = nullptr;
     if(iev >= 0){
         TRENToSampler= new TransverPositionSampler( f_trento, iev);
     }
@@ -105,13 +127,21 @@ PythiaGen::PythiaGen(std::string f_pythia, std::string f_trento,double pTHL, dou
     std::ostringstream s1, s2, s3, s4;
     s1 << "PhaseSpace:pTHatMin = " << pTHL;
     s2 << "PhaseSpace:pTHatMax = " << pTHH;
-    s3 << "Random:seed = " << processid;
+    s3 << "Random:seed = " << (seed >= 0 ? seed : processid);
     s4 << "TimeShower:pTmin = " << Q0;
     std::cout<< s4.str();
     pythia.readString(s1.str());
     pythia.readString(s2.str());
     pythia.readString(s3.str());
     pythia.readString(s4.str());
+    if (bias_power > 0.){
+        std::ostringstream s5, s6;
+        s5 << "PhaseSpace:bias2SelectionPow = " << bias_power;
+        s6 << "PhaseSpace:bias2SelectionRef = " << std::max(pTHL, 1.);
+        pythia.readString("PhaseSpace:bias2Selection = on");
+        pythia.readString(s5.str());
+        pythia.readString(s6.str());
+    }
     // Init
     pythia.init();
     for (int i=0; i<100; i++){
@@ -124,6 +154,8 @@ bool PythiaGen::Generate(std::vector<particle> & plist){
     if(_iev >= 0){
         TRENToSampler-> SampleXY(y, x); // (x,y)? output to chc
     }
+    // production vertex of the event
+    _x0 = fourvec{0., x, y, 0.};
     plist.clear();
    
     pythia.next();
@@ -144,7 +176,12 @@ bool PythiaGen::Generate(std::vector<particle> & plist){
     
     sigma0 = sg*pythia.info.weight() ;
     auto & event = pythia.event;
-    color_count = event.lastColTag()+1;
+    // formation times of all entries in lab frame
+    std::vector<double> tForm;
+    formation_times(event, tForm);
+    // the global color_count is set by the consumer of the event (see
+    // color_tag), since generators may run in several threads
+    _color_tag = event.lastColTag()+1;
     for (size_t i = 0; i < event.size(); ++i) {
         auto p = event[i];
         int absid = p.idAbs();
@@ -172,11 +209,8 @@ bool PythiaGen::Generate(std::vector<particle> & plist){
             // initialize momentum in coordinate co-moving frame
             _p.p0 = p0.boost_to(0., 0., p0.z()/p0.t());
             _p.p = _p.p0; 
-            // Get formation time in Lab frame
-            double tForm = 0.;
-            reference_pmu(i, tForm, event);
             // Transform to foramtion time in proper time
-            _p.tau0 = tForm*_p.p.t()/p0.t();
+            _p.tau0 = tForm[i]*_p.p.t()/p0.t();
             // Virtuality of particle production
             _p.Q0 = Q0;
             _p.Q00 = Q0;
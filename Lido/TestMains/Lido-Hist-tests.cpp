@@ -0,0 +1,54 @@
+#include <iostream>
+#include <vector>
+#include <stdexcept>
+
+#include "Histogram.h"
+
+// Histogram::merge: two partial histograms filled with the two halves of
+// a sample and merged must equal the histogram filled with the whole
+// sample (the weights are chosen such that all sums are exact), and
+// histograms with different binning must not merge.
+int test_merge(void){
+    HistAxis x({0., 1., 2., 4.}), y({-1., 0., 1.}, true);
+    Histogram all(x, y, 2), part1(x, y, 2), part2(x, y, 2);
+    int n = 1000;
+    for (int i=0; i<n; i++){
+        double u = 4.*i/n, v = -1.+2.*((7*i)%n)/n, w = .5*(i%8);
+        int ix = x.find(u), iy = y.find(v);
+        if (ix<0 || iy<0) continue;
+        Histogram & H = (i < n/2) ? part1 : part2;
+        for (int c=0; c<2; c++){
+            all.fill(all.index(ix, iy, c), w);
+            H.fill(H.index(ix, iy, c), w);
+        }
+    }
+    part1.merge(part2);
+    int failed = 0;
+    for (size_t i=0; i<all.length(); i++){
+        if (part1.sumw(i) != all.sumw(i) || part1.sumw2(i) != all.sumw2(i)) {
+            std::cout << "merge: entry " << i << " differs" << std::endl;
+            failed ++;
+        }
+    }
+    Histogram other(HistAxis({0., 1., 2., 3.}), y, 2);
+    try{
+        part1.merge(other);
+        std::cout << "merge: different binning was accepted" << std::endl;
+        failed ++;
+    }
+    catch (const std::invalid_argument & e){}
+    Histogram fewer(x, y, 1);
+    try{
+        part1.merge(fewer);
+        std::cout << "merge: different ncomp was accepted" << std::endl;
+        failed ++;
+    }
+    catch (const std::invalid_argument & e){}
+    return failed;
+}
+
+int main(){
+    int failed = test_merge();
+    std::cout << (failed ? "FAILED" : "passed") << std::endl;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,81 @@
+#include <string>
+#include <vector>
+#include <iostream>
+#include <exception>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/program_options.hpp>
+
+#include "simpleLogger.h"
+#include "jet_finding.h"
+
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+
+int main(int argc, char* argv[]){
+    using OptDesc = po::options_description;
+    OptDesc options{};
+    options.add_options()
+          ("help,h", "show this help message and exit")
+          ("response-table,r", 
+            po::value<fs::path>()->value_name("PATH")->required(),
+           "response table in HDF5 format")
+          ("output,o", 
+            po::value<fs::path>()->value_name("PATH")->required(),
+           "flat response table to be memory-mapped")
+          ("generate", po::bool_switch(),
+           "compute the HDF5 table first (continues from <response-table>.partial if present)")
+          ("grid", 
+            po::value<std::vector<size_t> >()->multitoken()->value_name("N N N N"),
+           "grid points in (rap, phi, pTmin/T, vperp) of a generated table, default 16 16 31 10")
+          ("checkpoint-interval", 
+            po::value<double>()->value_name("DOUBLE")->default_value(600.,"600"),
+           "seconds between checkpoints while generating")
+         ;
+    po::variables_map args{};
+    try{
+        po::store(po::command_line_parser(argc, argv).options(options).run(), args);
+        if (args.count("help")){
+                std::cout << "usage: " << argv[0] << " [options]\n"
+                          << options;
+                return 0;
+        }    
+        if (!args.count("response-table")){
+            throw po::required_option{"<response-table>"};
+            return 1;
+        }
+        else if (!args["generate"].as<bool>()){
+            if (!fs::exists(args["response-table"].as<fs::path>())){
+                throw po::error{"<response-table> path does not exist"};
+                return 1;
+            }
+        }
+        if (!args.count("output")){
+            throw po::required_option{"<output>"};
+            return 1;
+        }
+        std::vector<size_t> shape({16, 16, 31, 10});
+        if (args.count("grid")) shape = args["grid"].as<std::vector<size_t> >();
+        if (shape.size()!=4) throw po::error{"<grid> needs four numbers"};
+        MediumResponse MR("Gmu", shape);
+        if (args["generate"].as<bool>())
+            MR.init(args["response-table"].as<fs::path>().string(),
+                    args["checkpoint-interval"].as<double>());
+        else
+            MR.load(args["response-table"].as<fs::path>().string());
+        MR.convert(args["output"].as<fs::path>().string());
+    } 
+    catch (const po::required_option& e){
+        std::cout << e.what() << "\n";
+        std::cout << "usage: " << argv[0] << " [options]\n"
+                  << options;
+        return 1;
+    }
+    catch (const std::exception& e) {
+       // For all other exceptions just output the error message.
+       std::cerr << e.what() << '\n';
+       return 1;
+    }
+
+    return 0;
+}
@@ -21,7 +21,7 @@
 namespace po = boost::program_options;
 namespace fs = boost::filesystem;
 
-void output_jet(std::string fname, std::vector<particle> plist){
+void output_jet(std::string fname, std::vector<particle> & plist){
     std::ofstream f(fname);
     for (auto & p : plist) f << p.pid << " " << p.p << " " << p.x << " " << p.Q0 << std::endl;
     f.close();
@@ -165,14 +165,16 @@ int main(int argc, char* argv[]){
             double current_hydro_clock = med1.get_tauL();
             double hydro_dtau = med1.get_hydro_time_step();
             double dtau = hydro_dtau, DeltaTau;
+            // partons are moved (not copied) into the reusable buffer
+            // together with the outgoing ones, then the two lists are swapped
             new_plist.clear();
             for (auto & p : plist){     
                 if (p.Tf < 0.15) {
-                    new_plist.push_back(p);
+                    new_plist.push_back(std::move(p));
                     continue;       
                 }
                 if (p.x.tau() > current_hydro_clock+dtau){
-                    new_plist.push_back(p);
+                    new_plist.push_back(std::move(p));
                     continue;
                 }
                 else{
@@ -184,14 +186,16 @@ int main(int argc, char* argv[]){
                 med1.interpolate(p.x, T, vx, vy, vz);
                 double vzgrid = p.x.z()/p.x.t();
                 fourvec ploss = p.p;
+                pOut_list.clear();
                 int fs_size = update_particle_momentum_Lido(
                       DeltaTau, T, {vx, vy, vz}, p, pOut_list);
                  
                 for (auto & fp : pOut_list) {
                     ploss = ploss - fp.p;
-                    new_plist.push_back(fp);
+                    new_plist.push_back(std::move(fp));
                 }   
             }
+            plist.swap(new_plist);
             if (Nstep%10==0){
                 std::stringstream fname;
                 fname << args["output"].as<fs::path>().string()
@@ -200,7 +204,6 @@ int main(int argc, char* argv[]){
                 output_jet(fname.str(), plist);
                 iFrame ++;
             }
-            plist = new_plist;
             Nstep ++;
          }
        }
@@ -0,0 +1,67 @@
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include "Histogram.h"
+
+HistAxis::HistAxis(): edges({0., 1.}), left_closed(false), uniform(true), dx(1.){
+}
+
+HistAxis::HistAxis(std::vector<double> _edges, bool _left_closed):
+edges(_edges), left_closed(_left_closed), uniform(true), dx(0.){
+    if (edges.size()<2)
+        throw std::invalid_argument("a histogram axis needs at least two edges");
+    dx = (edges.back()-edges.front())/size();
+    for (size_t i=0; i<size(); i++){
+        if (std::abs(width(i)-dx) > 1e-9*std::abs(dx)) uniform = false;
+    }
+}
+
+bool HistAxis::inside(double x, size_t i) const{
+    return (left_closed ? edges[i]<=x : edges[i]<x) && x<edges[i+1];
+}
+
+int HistAxis::find(double x) const{
+    if (!(x>=edges.front() && x<edges.back())) return -1;
+    int n = int(size()), i;
+    if (uniform) {
+        // the guess is off by at most one bin due to rounding
+        i = std::min(std::max(int((x-edges.front())/dx), 0), n-1);
+        if (x<edges[i] && i>0) i--;
+        else if (x>=edges[i+1] && i<n-1) i++;
+    }
+    else {
+        i = int(std::upper_bound(edges.begin(), edges.end(), x)-edges.begin())-1;
+    }
+    return inside(x, i) ? i : -1;
+}
+
+bool HistAxis::operator==(const HistAxis & other) const{
+    return edges==other.edges && left_closed==other.left_closed;
+}
+
+Histogram::Histogram(): _ny(1), _ncomp(1), _sumw(1, 0.), _sumw2(1, 0.){
+}
+
+Histogram::Histogram(HistAxis x, int ncomp):
+X(x), Y(), _ny(1), _ncomp(ncomp),
+_sumw(X.size()*ncomp, 0.), _sumw2(X.size()*ncomp, 0.){
+}
+
+Histogram::Histogram(HistAxis x, HistAxis y, int ncomp):
+X(x), Y(y), _ny(y.size()), _ncomp(ncomp),
+_sumw(X.size()*Y.size()*ncomp, 0.), _sumw2(X.size()*Y.size()*ncomp, 0.){
+}
+
+void Histogram::reset(void){
+    std::fill(_sumw.begin(), _sumw.end(), 0.);
+    std::fill(_sumw2.begin(), _sumw2.end(), 0.);
+}
+
+void Histogram::merge(const Histogram & other){
+    if (!(X==other.X && Y==other.Y && _ncomp==other._ncomp))
+        throw std::invalid_argument("cannot merge histograms with different binning");
+    for (size_t i=0; i<_sumw.size(); i++) {
+        _sumw[i] += other._sumw[i];
+        _sumw2[i] += other._sumw2[i];
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <vector>
+#include <cstddef>
+
+// Bin edges of a histogram axis.
+// x falls into bin i if edges[i] < x < edges[i+1], or with left_closed
+// if edges[i] <= x < edges[i+1]; find() returns -1 for values outside of
+// all bins. Equally spaced edges are located arithmetically, others by
+// binary search.
+class HistAxis{
+public:
+    HistAxis();
+    HistAxis(std::vector<double> edges, bool left_closed=false);
+    int find(double x) const;
+    size_t size(void) const {return edges.size()-1;}
+    double low(size_t i) const {return edges[i];}
+    double high(size_t i) const {return edges[i+1];}
+    double width(size_t i) const {return edges[i+1]-edges[i];}
+    double center(size_t i) const {return (edges[i]+edges[i+1])/2.;}
+    const std::vector<double> & bins(void) const {return edges;}
+    bool operator==(const HistAxis & other) const;
+private:
+    bool inside(double x, size_t i) const;
+    std::vector<double> edges;
+    bool left_closed, uniform;
+    double dx;
+};
+
+// Weighted histogram on one or two axes with ncomp values per bin
+// (e.g. the cos and sin parts of a Q-vector). The sums of weights and of
+// squared weights are stored contiguously, entry (ix, iy, c) at
+// index(ix, iy, c) = (ix*ny+iy)*ncomp+c. Histograms with the same axes
+// can be merged, e.g. the partial histograms filled by several threads.
+class Histogram{
+public:
+    Histogram();
+    Histogram(HistAxis x, int ncomp=1);
+    Histogram(HistAxis x, HistAxis y, int ncomp=1);
+    const HistAxis & xaxis(void) const {return X;}
+    const HistAxis & yaxis(void) const {return Y;}
+    size_t nx(void) const {return X.size();}
+    size_t ny(void) const {return _ny;}
+    size_t length(void) const {return _sumw.size();}
+    size_t index(int ix, int iy=0, int c=0) const {
+        return (ix*_ny+iy)*_ncomp+c;
+    }
+    // add one entry of weight w, or n entries of weight w, to entry i
+    void fill(size_t i, double w) {
+        _sumw[i] += w;
+        _sumw2[i] += w*w;
+    }
+    void fill(size_t i, double w, int n) {
+        _sumw[i] += n*w;
+        _sumw2[i] += n*(w*w);
+    }
+    double sumw(size_t i) const {return _sumw[i];}
+    double sumw2(size_t i) const {return _sumw2[i];}
+    void reset(void);
+    void merge(const Histogram & other);
+private:
+    HistAxis X, Y;
+    size_t _ny, _ncomp;
+    std::vector<double> _sumw, _sumw2;
+};
+
+#endif
@@ -4,9 +4,11 @@
 #include <sstream>
 #include <algorithm>
 #include <iterator>
+#include <memory>
 #include "Pythia8/Pythia.h"
 #include "Pythia8Plugins/FastJet3.h"
 #include "fastjet/Selector.hh"
+#include "Histogram.h"
 using namespace Pythia8;
 
 void splitToDouble(const string str, vector<double> &rst, char delim = ' ')
@@ -38,41 +40,71 @@ std::string to_string_with_precision(const T a_value, const int n = 2)
 	return out.str();
 }
 
+// Jet definition, rapidity selection and histogram of one (clusterPower, 
+// jetRadius) configuration. The jet definition and the selector are built
+// once and reused for every event.
 class JetAnalyzer{
 
     protected:
     std::string analyzeType;
-    std::fstream fs;
     std::vector<double> outputBins;
-    std::vector<double> rst;
-    std::vector<double> sqSum;
-    std::vector<double> err;
+    // jets per bin of outputBins[j] <= x < outputBins[j+1]
+    Histogram hist;
     int clusterPower;
     double jetRadius;
     double jetpTMin;
     double jetyMin;
     double jetyMax;
+    fastjet::JetDefinition jetDef;
+    fastjet::Selector select_rapidity;
 
     public: 
     JetAnalyzer(std::string analyzeType, std::vector<double> outputBins, double clusterPower, double jetRadius
    , double jetpTMin, double jetyMin, double jetyMax): analyzeType(analyzeType), outputBins(outputBins), 
-   clusterPower(clusterPower), jetRadius(jetRadius), jetpTMin(jetpTMin), jetyMin(jetyMin), jetyMax(jetyMax) {
-fs.open("./jet_results/" + analyzeType + "_p=" + to_string(clusterPower)+ "_R=" + to_string(jetRadius) + "_y=" + to_string(jetyMin) + "-" + to_string(jetyMax) + "_pTMin" + to_string(jetpTMin) + ".dat", std::fstream::out);
-
-    rst=std::vector<double>(outputBins.size(), 0.);
-	err=std::vector<double>(outputBins.size(), 0.);
-    sqSum=std::vector<double>(outputBins.size(), 0.);
+   clusterPower(clusterPower), jetRadius(jetRadius), jetpTMin(jetpTMin), jetyMin(jetyMin), jetyMax(jetyMax),
+   jetDef((clusterPower == 1 || clusterPower == -1) ? 
+          fastjet::JetDefinition(fastjet::genkt_algorithm, jetRadius, clusterPower) :
+          fastjet::JetDefinition(fastjet::cambridge_algorithm, jetRadius)),
+   select_rapidity(fastjet::SelectorRapRange(jetyMin, jetyMax)) {
+    hist = Histogram(HistAxis(outputBins, true));
    };
+   virtual ~JetAnalyzer() {}
+
+   virtual void doJetFinding(const std::vector<fastjet::PseudoJet> & fjInputs, double weight) {}
 
-   void doJetFinding(std::vector<fastjet::PseudoJet> fjInputs) {}
+   std::string name() const {
+    return analyzeType + "_p=" + to_string(clusterPower)+ "_R=" + to_string(jetRadius) + "_y=" + to_string(jetyMin) + "-" + to_string(jetyMax) + "_pTMin" + to_string(jetpTMin);
+   }
 
-   void outputResults() {
+   // one block per configuration: a "# name" line, then pT, dsigma/dpT, 
+   // error per line, blocks are separated by two empty lines
+   void outputResults(std::ostream & fs) {
+    fs << "# " << name() << endl;
     for (unsigned int j = 0; j < outputBins.size() - 1; j++)
 	{
-		err[j] = rst[j] / sqrt(pow(rst[j], 2) / sqSum[j]);
-		fs << (outputBins[j] + outputBins[j + 1]) / 2 << " " << rst[j] / (outputBins[j + 1] - outputBins[j]) << " " << err[j] / (outputBins[j + 1] - outputBins[j]) << endl;
+		double rst = hist.sumw(j), sqSum = hist.sumw2(j);
+		double err = rst / sqrt(pow(rst, 2) / sqSum);
+		fs << (outputBins[j] + outputBins[j + 1]) / 2 << " " << rst / (outputBins[j + 1] - outputBins[j]) << " " << err / (outputBins[j + 1] - outputBins[j]) << endl;
 	}
-    fs.close();
+    fs << endl << endl;
    }
 
-};
\ No newline at end of file
+};
+
+// Several analyses, e.g. of different (clusterPower, jetRadius), run over
+// the same inputs in one pass and written to a single file.
+class JetAnalyzerSet{
+    public:
+    void add(std::shared_ptr<JetAnalyzer> analyzer) {
+        analyzers.push_back(analyzer);
+    }
+    void doJetFinding(const std::vector<fastjet::PseudoJet> & fjInputs, double weight) {
+        for (auto & a : analyzers) a->doJetFinding(fjInputs, weight);
+    }
+    void outputResults(std::string fname) {
+        std::ofstream fs(fname);
+        for (auto & a : analyzers) a->outputResults(fs);
+    }
+    private:
+    std::vector<std::shared_ptr<JetAnalyzer> > analyzers;
+};
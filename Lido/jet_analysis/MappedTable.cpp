@@ -0,0 +1,249 @@
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "MappedTable.h"
+#include "simpleLogger.h"
+
+namespace {
+const char magic[8] = {'L','I','D','O','T','A','B','1'};
+
+struct header{
+    char magic[8];
+    uint64_t rank, ncomp;
+    uint64_t shape[MappedTable::MaxRank];
+    double low[MappedTable::MaxRank], high[MappedTable::MaxRank];
+};
+
+// the grid step (high-low)/(shape-1) needs at least two points per axis
+template<typename T>
+bool valid_shape(const T * shape, size_t rank){
+    if (rank < 1 || rank > MappedTable::MaxRank) return false;
+    for (size_t d=0; d<rank; d++) 
+        if (shape[d] < 2) return false;
+    return true;
+}
+
+// number of values ncomp*prod(shape) of a table with a valid shape, false
+// if ncomp is zero or the table has more than nmax values (the product is
+// checked step by step, so it can not overflow)
+template<typename T>
+bool table_length(const T * shape, size_t rank, uint64_t ncomp, uint64_t nmax, 
+                  uint64_t & length){
+    if (ncomp < 1 || ncomp > nmax) return false;
+    length = ncomp;
+    for (size_t d=0; d<rank; d++){
+        if (length > nmax/shape[d]) return false;
+        length *= shape[d];
+    }
+    return true;
+}
+}
+
+MappedTable::MappedTable():_base(nullptr), _bytes(0), _rank(0), _ncomp(0), _data(nullptr){
+}
+
+MappedTable::~MappedTable(){
+    Close();
+}
+
+void MappedTable::Close(void){
+    if (_base != nullptr) munmap(_base, _bytes);
+    _base = nullptr;
+    _data = nullptr;
+    _bytes = 0;
+    _owned.clear();
+}
+
+void MappedTable::SetGrid(const uint64_t * shape, const double * low, const double * high){
+    for (size_t d=0; d<_rank; d++){
+        _shape[d] = shape[d];
+        _low[d] = low[d];
+        _step[d] = (high[d]-low[d])/(_shape[d]-1);
+    }
+}
+
+void MappedTable::Assign(std::vector<size_t> shape, 
+                         std::vector<double> low, 
+                         std::vector<double> high,
+                         size_t ncomp,
+                         std::vector<double> values){
+    if (!valid_shape(shape.data(), shape.size()))
+        throw std::invalid_argument("a table needs at least two grid points per axis");
+    uint64_t length;
+    if (!table_length(shape.data(), shape.size(), ncomp, values.size(), length) 
+        || length != values.size())
+        throw std::invalid_argument("the values do not match the shape and ncomp of the table");
+    Close();
+    std::vector<uint64_t> s(shape.begin(), shape.end());
+    _rank = shape.size();
+    _ncomp = ncomp;
+    SetGrid(s.data(), low.data(), high.data());
+    _owned.swap(values);
+    _data = _owned.data();
+}
+
+bool MappedTable::IsMapped(std::string fname){
+    std::ifstream f(fname, std::ios::binary);
+    char buffer[8];
+    if (!f.read(buffer, 8)) return false;
+    return std::memcmp(buffer, magic, 8) == 0;
+}
+
+bool MappedTable::Open(std::string fname){
+    Close();
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG_INFO << "Cannot open " << fname;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < Alignment) {
+        close(fd);
+        LOG_INFO << fname << " is not a flat table";
+        return false;
+    }
+    _bytes = st.st_size;
+    _base = mmap(nullptr, _bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (_base == MAP_FAILED) {
+        _base = nullptr;
+        LOG_INFO << "Cannot map " << fname;
+        return false;
+    }
+    const header * h = static_cast<const header *>(_base);
+    uint64_t length;
+    if (std::memcmp(h->magic, magic, 8) != 0 || !valid_shape(h->shape, h->rank)) {
+        Close();
+        LOG_INFO << fname << " is not a flat table";
+        return false;
+    }
+    _rank = h->rank;
+    _ncomp = h->ncomp;
+    // the data must fit into the mapped file after the header
+    if (!table_length(h->shape, h->rank, h->ncomp, 
+                      (_bytes-Alignment)/sizeof(double), length)) {
+        Close();
+        LOG_INFO << fname << " is truncated or has a corrupted header";
+        return false;
+    }
+    SetGrid(h->shape, h->low, h->high);
+    _data = reinterpret_cast<const double *>(static_cast<const char *>(_base) + Alignment);
+    return true;
+}
+
+bool MappedTable::Write(std::string fname, 
+                        std::vector<size_t> shape, 
+                        std::vector<double> low, 
+                        std::vector<double> high,
+                        size_t ncomp,
+                        const std::vector<double> & values){
+    if (!valid_shape(shape.data(), shape.size())) {
+        LOG_INFO << "Cannot write " << fname 
+                 << ", a table needs at least two grid points per axis";
+        return false;
+    }
+    uint64_t length;
+    if (!table_length(shape.data(), shape.size(), ncomp, values.size(), length) 
+        || length != values.size()) {
+        LOG_INFO << "Cannot write " << fname 
+                 << ", the values do not match the shape and ncomp of the table";
+        return false;
+    }
+    header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, magic, 8);
+    h.rank = shape.size();
+    h.ncomp = ncomp;
+    for (size_t d=0; d<shape.size(); d++){
+        h.shape[d] = shape[d];
+        h.low[d] = low[d];
+        h.high[d] = high[d];
+    }
+    std::vector<char> padding(Alignment-sizeof(h), 0);
+    // write to a temporary file first, so that other processes never 
+    // see a partially written table
+    std::string tmpname = fname + ".tmp" + std::to_string(getpid());
+    std::ofstream f(tmpname, std::ios::binary);
+    f.write(reinterpret_cast<const char *>(&h), sizeof(h));
+    f.write(padding.data(), padding.size());
+    f.write(reinterpret_cast<const char *>(values.data()), values.size()*sizeof(double));
+    f.close();
+    if (!f || std::rename(tmpname.c_str(), fname.c_str()) != 0) {
+        std::remove(tmpname.c_str());
+        LOG_INFO << "Cannot write " << fname;
+        return false;
+    }
+    return true;
+}
+
+void MappedTable::Interpolate(const double * x, double * result) const{
+    size_t index[MaxRank];
+    double w[MaxRank];
+    for (size_t d=0; d<_rank; d++){
+        double u = (x[d]-_low[d])/_step[d];
+        u = std::max(0., std::min(u, _shape[d]-1.));
+        size_t n = std::min(size_t(u), _shape[d]-2);
+        index[d] = n;
+        w[d] = u - n;
+    }
+    for (size_t c=0; c<_ncomp; c++) result[c] = 0.;
+    for (size_t corner=0; corner < (size_t(1)<<_rank); corner++){
+        double weight = 1.;
+        size_t offset = 0;
+        for (size_t d=0; d<_rank; d++){
+            size_t bit = (corner>>d) & 1;
+            weight *= bit ? w[d] : 1.-w[d];
+            offset = offset*_shape[d] + index[d] + bit;
+        }
+        const double * v = _data + offset*_ncomp;
+        for (size_t c=0; c<_ncomp; c++) result[c] += weight*v[c];
+    }
+}
+
+void MappedTable::Interpolate(size_t n, const double * x, double * result) const{
+    // stride of each dimension in units of doubles
+    size_t stride[MaxRank];
+    stride[_rank-1] = _ncomp;
+    for (size_t d=_rank-1; d>0; d--) stride[d-1] = stride[d]*_shape[d];
+    // lower corner of the cell and the weights of each point
+    std::vector<size_t> offset(n, 0);
+    std::vector<double> w(n*_rank), weight(n);
+    for (size_t d=0; d<_rank; d++){
+        const double low = _low[d], step = _step[d], umax = _shape[d]-1.;
+        const size_t nmax = _shape[d]-2, sd = stride[d];
+        double * wd = &w[d*n];
+        for (size_t i=0; i<n; i++){
+            double u = (x[i*_rank+d]-low)/step;
+            u = std::max(0., std::min(u, umax));
+            size_t k = std::min(size_t(u), nmax);
+            offset[i] += k*sd;
+            wd[i] = u - k;
+        }
+    }
+    for (size_t i=0; i<n*_ncomp; i++) result[i] = 0.;
+    for (size_t corner=0; corner < (size_t(1)<<_rank); corner++){
+        size_t shift = 0;
+        for (size_t i=0; i<n; i++) weight[i] = 1.;
+        for (size_t d=0; d<_rank; d++){
+            const double * wd = &w[d*n];
+            if ((corner>>d) & 1) {
+                shift += stride[d];
+                for (size_t i=0; i<n; i++) weight[i] *= wd[i];
+            }
+            else {
+                for (size_t i=0; i<n; i++) weight[i] *= 1.-wd[i];
+            }
+        }
+        const double * v = _data + shift;
+        for (size_t i=0; i<n; i++){
+            for (size_t c=0; c<_ncomp; c++)
+                result[i*_ncomp+c] += weight[i]*v[offset[i]+c];
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef MAPPED_TABLE_H
+#define MAPPED_TABLE_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// A read-only N-dimensional table of doubles stored in a flat binary file
+// and memory-mapped instead of copied onto the heap, so that all processes
+// on a node reading the same table share one copy in the page cache.
+// The same layout can also be held on the heap (Assign), e.g. for tables
+// just computed or read from HDF5.
+// File layout: a fixed header padded to Alignment bytes, followed by the
+// grid values in row-major order (last index fastest), Ncomp values per
+// grid point. The grid is node based, x_i = low + i*(high-low)/(shape-1),
+// with at least two points per axis.
+class MappedTable{
+public:
+    static const size_t MaxRank = 8;
+    static const size_t Alignment = 4096;
+    MappedTable();
+    ~MappedTable();
+    MappedTable(const MappedTable &) = delete;
+    MappedTable & operator=(const MappedTable &) = delete;
+    bool Open(std::string fname);
+    void Assign(std::vector<size_t> shape, 
+                std::vector<double> low, 
+                std::vector<double> high,
+                size_t ncomp, 
+                std::vector<double> values);
+    void Close(void);
+    bool is_open(void) const {return _data != nullptr;}
+    size_t rank(void) const {return _rank;}
+    size_t ncomp(void) const {return _ncomp;}
+    size_t shape(size_t i) const {return _shape[i];}
+    double low(size_t i) const {return _low[i];}
+    double step(size_t i) const {return _step[i];}
+    const double * data(void) const {return _data;}
+    // multilinear interpolation of all components at point x,
+    // points outside the grid take the value at the closest edge
+    void Interpolate(const double * x, double * result) const;
+    // the same for n points at once, x[i*rank+d] is the d-th coordinate of 
+    // the i-th point and result[i*ncomp+c] its c-th component. The corner 
+    // offsets and weights are computed dimension by dimension over all 
+    // points and the corners are gathered with a fixed stride, so that 
+    // the loops over points vectorize.
+    void Interpolate(size_t n, const double * x, double * result) const;
+    // check whether a file is a flat table (instead of e.g. HDF5)
+    static bool IsMapped(std::string fname);
+    // write a table, the file is renamed into place once complete
+    static bool Write(std::string fname, 
+                      std::vector<size_t> shape, 
+                      std::vector<double> low, 
+                      std::vector<double> high,
+                      size_t ncomp, 
+                      const std::vector<double> & values);
+private:
+    void SetGrid(const uint64_t * shape, const double * low, const double * high);
+    void * _base;
+    std::vector<double> _owned;
+    size_t _bytes, _rank, _ncomp;
+    size_t _shape[MaxRank];
+    double _low[MaxRank], _step[MaxRank];
+    const double * _data;
+};
+
+#endif
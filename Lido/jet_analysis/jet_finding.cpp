@@ -8,103 +8,357 @@
 #include "integrator.h"
 #include <sstream>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <algorithm>
 #include <gsl/gsl_sf_gamma.h>
 
 bool compare_jet(Fjet A, Fjet B){
     return (A.pT > B.pT);
 }
 
-MediumResponse::MediumResponse(std::string _name): name(_name){
-    std::vector<size_t> shape;
+// index i of the bin bins[i] < x <= bins[i+1], -1 if there is none
+int bin_index_right_closed(const std::vector<double> & bins, double x){
+    int i = int(std::lower_bound(bins.begin(), bins.end(), x)-bins.begin())-1;
+    return (i>=0 && i<int(bins.size())-1) ? i : -1;
+}
+
+// index i of the bin bins[i] <= x < bins[i+1], -1 if there is none
+int bin_index_left_closed(const std::vector<double> & bins, double x){
+    int i = int(std::upper_bound(bins.begin(), bins.end(), x)-bins.begin())-1;
+    return (i>=0 && i<int(bins.size())-1) ? i : -1;
+}
+
+EtaPhiGrid::EtaPhiGrid(double _etamin, double _etamax, double _cell):
+etamin(_etamin), etamax(_etamax), cell(_cell),
+Neta(std::max(1, int(std::ceil((_etamax-_etamin)/_cell)))),
+Nphi(std::max(1, int(2.*M_PI/_cell))){
+    start.assign(Neta*Nphi+1, 0);
+}
+
+// particles outside of [etamin, etamax] go to the first or last row
+int EtaPhiGrid::eta_cell(double eta) const{
+    int i = int(std::floor((eta-etamin)/cell));
+    return std::min(std::max(i, 0), Neta-1);
+}
+
+int EtaPhiGrid::phi_cell(double phi) const{
+    int j = int(std::floor((phi+M_PI)/(2.*M_PI)*Nphi));
+    return ((j%Nphi)+Nphi)%Nphi;
+}
+
+void EtaPhiGrid::build(const std::vector<particle> & plist){
+    std::vector<int> cells(plist.size());
+    start.assign(Neta*Nphi+1, 0);
+    for (size_t k=0; k<plist.size(); k++){
+        cells[k] = eta_cell(plist[k].p.pseudorap())*Nphi 
+                 + phi_cell(plist[k].p.phi());
+        start[cells[k]+1] ++;
+    }
+    for (int c=0; c<Neta*Nphi; c++) start[c+1] += start[c];
+    std::vector<size_t> fill(start.begin(), start.end()-1);
+    items.resize(plist.size());
+    for (size_t k=0; k<plist.size(); k++) items[fill[cells[k]]++] = k;
+}
+
+void EtaPhiGrid::query(double eta, double phi, double R, 
+                       std::vector<size_t> & result) const{
+    result.clear();
+    int i0 = eta_cell(eta-R), i1 = eta_cell(eta+R);
+    int nj = int(std::floor((phi+R+M_PI)/(2.*M_PI)*Nphi))
+           - int(std::floor((phi-R+M_PI)/(2.*M_PI)*Nphi)) + 1;
+    nj = std::min(nj, Nphi);
+    int j0 = phi_cell(phi-R);
+    for (int i=i0; i<=i1; i++){
+        for (int dj=0; dj<nj; dj++){
+            int c = i*Nphi + (j0+dj)%Nphi;
+            for (size_t k=start[c]; k<start[c+1]; k++) 
+                result.push_back(items[k]);
+        }
+    }
+    std::sort(result.begin(), result.end());
+}
+
+MediumResponse::MediumResponse(std::string _name): 
+MediumResponse(_name, {16, 16, 31, 10}){
+}
+
+// G^mu(-rap, phi) = (G^0, G^x, G^y, -G^z)(rap, phi) and
+// G^mu(rap, -phi) = (G^0, G^x, -G^y, G^z)(rap, phi), so only 
+// 0 <= rap <= 3 and 0 <= phi <= pi are tabulated
+MediumResponse::MediumResponse(std::string _name, std::vector<size_t> shape): 
+name(_name), folded(true){
+    if (shape.size()!=4)
+        throw std::invalid_argument("the response table has four dimensions");
     std::vector<double> low, high;
-    shape.resize(4);
     low.resize(4);
     high.resize(4);
-    low[0] = -3.; low[1] = -M_PI; low[2] = 0.; low[3] = 0.0;
+    low[0] = 0.; low[1] = 0.; low[2] = 0.; low[3] = 0.0;
     high[0] = 3.; high[1] = M_PI; high[2] = 30.; high[3] = 0.9;
-    shape[0] = 30; shape[1] = 30; shape[2] = 31; shape[3] = 10;
     Gmu = std::make_shared<TableBase<fourvec, 4>>(name, shape, low, high);
 }
 
 void MediumResponse::load(std::string fname){
-    Gmu->Load(fname);
+    if (MappedTable::IsMapped(fname)){
+        GmuFlat = std::make_shared<MappedTable>();
+        if (!GmuFlat->Open(fname) || GmuFlat->rank()!=4 || GmuFlat->ncomp()!=4)
+            throw std::runtime_error(fname+" is not a valid response table");
+        // tables of the full rap and phi range are used as they are
+        folded = GmuFlat->low(0)>=0. && GmuFlat->low(1)>=0.;
+        LOG_INFO << fname << " mapped";
+    }
+    else {
+        if (!Gmu->Load(fname)) {
+            std::vector<size_t> shape;
+            std::vector<double> low, high;
+            grid(shape, low, high);
+            // tables made before the folding cover the full rap and phi 
+            // range on a 30x30x31x10 grid, they are used unfolded
+            auto legacy = std::make_shared<TableBase<fourvec, 4>>(name, 
+                std::vector<size_t>{30, 30, 31, 10},
+                std::vector<double>{-3., -M_PI, 0., 0.},
+                std::vector<double>{3., M_PI, 30., 0.9});
+            if (!legacy->Load(fname)) {
+                std::stringstream msg;
+                msg << fname << " does not match the response grid " 
+                    << shape[0] << "x" << shape[1] << "x" << shape[2] << "x" << shape[3] 
+                    << " on rap [" << low[0] << ", " << high[0] << "], phi [" 
+                    << low[1] << ", " << high[1] << "], pTmin/T [" << low[2] << ", " 
+                    << high[2] << "], vperp [" << low[3] << ", " << high[3] << "]"
+                    << " nor the unfolded 30x30x31x10 grid on rap [-3, 3], phi [-pi, pi]";
+                throw std::runtime_error(msg.str());
+            }
+            LOG_INFO << fname << " is an unfolded response table";
+            Gmu = legacy;
+        }
+        flatten();
+    }
 }
 
-void MediumResponse::init(std::string fname){
-    LOG_INFO << fname << " Generating tables for approx medium response functions";
-    auto code = [this](int start, int end) { this->compute(start, end); };
-    std::vector<std::thread> threads;
-    size_t nthreads = std::thread::hardware_concurrency();
-    size_t padding = size_t(std::ceil(Gmu->length()*1./nthreads));
-    for(auto i=0; i<nthreads; ++i) {
-        int start = i*padding;
-        int end = std::min(padding*(i+1), Gmu->length());
-        threads.push_back( std::thread(code, start, end) );
+void MediumResponse::grid(std::vector<size_t> & shape, 
+                          std::vector<double> & low, 
+                          std::vector<double> & high){
+    std::vector<size_t> index;
+    shape.resize(4);
+    index.resize(4);
+    for(int d=0; d<4; d++) {
+        shape[d] = Gmu->shape(d);
+        index[d] = 0;
     }
-    for(auto& t : threads) t.join();
-    Gmu->Save(fname);
+    low = Gmu->parameters(index);
+    for(int d=0; d<4; d++) index[d] = shape[d]-1;
+    high = Gmu->parameters(index);
 }
 
-void MediumResponse::compute(int start, int end){
-    std::vector<size_t> index;
+void MediumResponse::flatten(void){
+    std::vector<size_t> shape, index;
+    std::vector<double> low, high;
+    grid(shape, low, high);
     index.resize(4);
-    for(auto i=start; i<end; ++i){
+    // at the grid points the interpolation returns the tabulated values
+    std::vector<double> values;
+    values.resize(Gmu->length()*4);
+    for(size_t i=0; i<Gmu->length(); ++i){
+        size_t q = i;
+        for(int d=4-1; d>=0; d--){
+            index[d] = q%shape[d];
+            q = q/shape[d];
+        }
+        auto gmu = Gmu->InterpolateTable(Gmu->parameters(index));
+        for(int k=0; k<4; k++) values[i*4+k] = gmu.a[k];
+    }
+    GmuFlat = std::make_shared<MappedTable>();
+    GmuFlat->Assign(shape, low, high, 4, values);
+    folded = low[0]>=0. && low[1]>=0.;
+}
+
+void MediumResponse::convert(std::string fname){
+    std::vector<size_t> shape;
+    std::vector<double> low, high;
+    size_t length = 1;
+    for(int d=0; d<4; d++) {
+        shape.push_back(GmuFlat->shape(d));
+        low.push_back(GmuFlat->low(d));
+        high.push_back(GmuFlat->low(d) + GmuFlat->step(d)*(shape[d]-1));
+        length *= shape[d];
+    }
+    std::vector<double> values(GmuFlat->data(), GmuFlat->data()+length*4);
+    if (!MappedTable::Write(fname, shape, low, high, 4, values))
+        throw std::runtime_error("cannot write "+fname);
+    LOG_INFO << fname << " written";
+}
+
+void MediumResponse::init(std::string fname, double checkpoint_interval){
+    LOG_INFO << fname << " Generating tables for approx medium response functions";
+    std::vector<size_t> shape;
+    std::vector<double> low, high;
+    grid(shape, low, high);
+    size_t length = Gmu->length();
+    // G^mu and a done flag (1.) for each grid point
+    std::vector<double> values(length*5, 0.);
+    std::string checkpoint = fname+".partial";
+    if (read_checkpoint(checkpoint, values)) 
+        LOG_INFO << "Restart from " << checkpoint;
+    std::vector<size_t> todo;
+    for(size_t i=0; i<length; ++i) {
+        if (values[i*5+4] == 0.) todo.push_back(i);
+    }
+    LOG_INFO << todo.size() << " of " << length << " grid points to compute";
+    // the cost of a grid point varies a lot with pTmin/T, so the threads
+    // take one point at a time from a shared counter
+    std::atomic<size_t> next(0);
+    std::mutex mtx;
+    auto last_checkpoint = std::chrono::steady_clock::now();
+    auto code = [&]() {
+        double gmu[4];
+        for(size_t k=next++; k<todo.size(); k=next++) {
+            compute(todo[k], gmu);
+            std::lock_guard<std::mutex> guard(mtx);
+            double * v = &values[todo[k]*5];
+            for(int c=0; c<4; c++) v[c] = gmu[c];
+            v[4] = 1.;
+            auto now = std::chrono::steady_clock::now();
+            if (std::chrono::duration<double>(now-last_checkpoint).count() 
+                > checkpoint_interval) {
+                if (MappedTable::Write(checkpoint, shape, low, high, 5, values))
+                    LOG_INFO << "Checkpoint " << checkpoint;
+                last_checkpoint = now;
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    size_t nthreads = std::max(1u, std::thread::hardware_concurrency());
+    for(size_t i=0; i<nthreads; ++i) threads.push_back( std::thread(code) );
+    for(auto& t : threads) t.join();
+    std::vector<size_t> index(4);
+    for(size_t i=0; i<length; ++i) {
         size_t q = i;
         for(int d=4-1; d>=0; d--){
-            size_t dim = Gmu->shape(d);
-            size_t n = q%dim;
-            q = q/dim;
-            index[d] = n;
+            index[d] = q%shape[d];
+            q = q/shape[d];
         }
-        auto params = Gmu->parameters(index);
-        double rap = params[0];
-        double phi = params[1];
-        double pTmin_over_T = params[2];
-        double vperp = params[3];
-        double cs = std::sqrt(0.2);
-        double chrap = std::cosh(rap);
-        double shrap = std::sinh(rap);
-        auto code = [rap, chrap, shrap, phi, pTmin_over_T, vperp, cs]
-                 (const double * X){
-            double costhetak = X[0];
-            double phik = X[1];
-            double yk = 0.5*std::log((1./cs+costhetak)/(1./cs-costhetak));
-            double sinthetak = std::sqrt(1.-costhetak*costhetak);
-            double gamma_vperp = 1./std::sqrt(1.-vperp*vperp);
-            double chyk = std::cosh(yk), shyk = std::sinh(yk);
-            double sigma = gamma_vperp * ( std::cosh(rap-yk)
-                                 - vperp * std::cos(phi-phik) );
-            double GInc = gsl_sf_gamma_inc_Q(5., pTmin_over_T*sigma);
-            double sigma_3rd = std::pow(sigma, 3);
-            double sigma_4th = std::pow(sigma, 4);
-            double A = (
-                     4./3.*gamma_vperp/sigma_3rd * (
-                chyk/cs - 3*(sinthetak*vperp + costhetak*shyk)
-                     )
-                   - 1./sigma_4th * (
-                chrap/cs - 3*(sinthetak*std::cos(phi-phik)+ shrap*costhetak)
-                     )
-                  ) * GInc * 3. / std::pow(4.*M_PI, 2);
-            std::vector<double> res;
-            res.resize(4);
-            res[0] = A*cs;
-            res[1] = A*sinthetak*std::cos(phik);
-            res[2] = A*sinthetak*std::sin(phik);
-            res[3] = A*costhetak;
-            return res;
-        };
-        double wmin[2] = {-.999, -M_PI};
-        double wmax[2] = {.999, M_PI};
-        double error;
-        std::vector<double> res = quad_nd(code, 2, 4, wmin, wmax, error, 1e-7);
-        fourvec gmu{res[0], res[1], res[2], res[3]};
-        Gmu->SetTableValue(index, gmu);
+        const double * v = &values[i*5];
+        Gmu->SetTableValue(index, fourvec{v[0], v[1], v[2], v[3]});
     }
+    Gmu->Save(fname);
+    std::remove(checkpoint.c_str());
+    flatten();
+}
+
+// copy the finished grid points of a checkpoint of the same grid
+bool MediumResponse::read_checkpoint(std::string fname, 
+                                     std::vector<double> & values){
+    if (!MappedTable::IsMapped(fname)) return false;
+    std::vector<size_t> shape;
+    std::vector<double> low, high;
+    grid(shape, low, high);
+    MappedTable partial;
+    if (!partial.Open(fname) || partial.rank()!=4 || partial.ncomp()!=5) 
+        return false;
+    for(int d=0; d<4; d++) {
+        double step = (high[d]-low[d])/(shape[d]-1);
+        if (partial.shape(d)!=shape[d] 
+            || std::abs(partial.low(d)-low[d]) > 1e-9*(1.+std::abs(low[d]))
+            || std::abs(partial.step(d)-step) > 1e-9*std::abs(step)) {
+            LOG_INFO << fname << " does not match the grid, ignored";
+            return false;
+        }
+    }
+    std::copy(partial.data(), partial.data()+values.size(), values.begin());
+    return true;
+}
+
+void MediumResponse::compute(size_t i, double * gmu){
+    std::vector<size_t> index;
+    index.resize(4);
+    size_t q = i;
+    for(int d=4-1; d>=0; d--){
+        size_t dim = Gmu->shape(d);
+        size_t n = q%dim;
+        q = q/dim;
+        index[d] = n;
+    }
+    auto params = Gmu->parameters(index);
+    double rap = params[0];
+    double phi = params[1];
+    double pTmin_over_T = params[2];
+    double vperp = params[3];
+    double cs = std::sqrt(0.2);
+    double chrap = std::cosh(rap);
+    double shrap = std::sinh(rap);
+    auto code = [rap, chrap, shrap, phi, pTmin_over_T, vperp, cs]
+             (const double * X){
+        double costhetak = X[0];
+        double phik = X[1];
+        double yk = 0.5*std::log((1./cs+costhetak)/(1./cs-costhetak));
+        double sinthetak = std::sqrt(1.-costhetak*costhetak);
+        double gamma_vperp = 1./std::sqrt(1.-vperp*vperp);
+        double chyk = std::cosh(yk), shyk = std::sinh(yk);
+        double sigma = gamma_vperp * ( std::cosh(rap-yk)
+                             - vperp * std::cos(phi-phik) );
+        double GInc = gsl_sf_gamma_inc_Q(5., pTmin_over_T*sigma);
+        double sigma_3rd = std::pow(sigma, 3);
+        double sigma_4th = std::pow(sigma, 4);
+        double A = (
+                 4./3.*gamma_vperp/sigma_3rd * (
+            chyk/cs - 3*(sinthetak*vperp + costhetak*shyk)
+                 )
+               - 1./sigma_4th * (
+            chrap/cs - 3*(sinthetak*std::cos(phi-phik)+ shrap*costhetak)
+                 )
+              ) * GInc * 3. / std::pow(4.*M_PI, 2);
+        std::vector<double> res;
+        res.resize(4);
+        res[0] = A*cs;
+        res[1] = A*sinthetak*std::cos(phik);
+        res[2] = A*sinthetak*std::sin(phik);
+        res[3] = A*costhetak;
+        return res;
+    };
+    double wmin[2] = {-.999, -M_PI};
+    double wmax[2] = {.999, M_PI};
+    double error;
+    std::vector<double> res = quad_nd(code, 2, 4, wmin, wmax, error, 1e-7);
+    for(int c=0; c<4; c++) gmu[c] = res[c];
 }
 
 double MediumResponse::get_dpT_dydphi(double rap, double phi, fourvec Pmu, double vperp, double pTmin_over_T){
-    auto gmu = Gmu->InterpolateTable({rap, phi, pTmin_over_T, vperp});
-    return gmu.t()*Pmu.t()+gmu.x()*Pmu.x()+gmu.y()*Pmu.y()+gmu.z()*Pmu.z();
+    double gmu[4];
+    get_Gmu(1, &rap, &phi, vperp, pTmin_over_T, gmu);
+    return gmu[0]*Pmu.t()+gmu[1]*Pmu.x()+gmu[2]*Pmu.y()+gmu[3]*Pmu.z();
+}
+
+void MediumResponse::get_dpT_dydphi(size_t n, const double * rap, const double * phi, 
+                                    const fourvec * Pmu, double vperp, double pTmin_over_T, 
+                                    double * dpT){
+    std::vector<double> gmu;
+    gmu.resize(4*n);
+    get_Gmu(n, rap, phi, vperp, pTmin_over_T, gmu.data());
+    for(size_t i=0; i<n; i++){
+        const double * g = &gmu[4*i];
+        dpT[i] = g[0]*Pmu[i].t()+g[1]*Pmu[i].x()+g[2]*Pmu[i].y()+g[3]*Pmu[i].z();
+    }
+}
+
+void MediumResponse::get_Gmu(size_t n, const double * rap, const double * phi, 
+                             double vperp, double pTmin_over_T, double * gmu){
+    std::vector<double> x;
+    x.resize(4*n);
+    for(size_t i=0; i<n; i++){
+        x[4*i] = folded ? std::abs(rap[i]) : rap[i];
+        x[4*i+1] = folded ? std::abs(phi[i]) : phi[i];
+        x[4*i+2] = pTmin_over_T;
+        x[4*i+3] = vperp;
+    }
+    GmuFlat->Interpolate(n, x.data(), gmu);
+    if (!folded) return;
+    for(size_t i=0; i<n; i++){
+        if (phi[i]<0.) gmu[4*i+2] = -gmu[4*i+2];
+        if (rap[i]<0.) gmu[4*i+3] = -gmu[4*i+3];
+    }
 }
 
 
@@ -114,20 +368,14 @@ JetFinder::JetFinder(int _Neta, int _Nphi, double _etamax, bool need_response_ta
  phimax(M_PI), phimin(-M_PI), 
  deta((etamax-etamin)/(_Neta-1)), 
  dphi((phimax-phimin)/Nphi),
- MR("Gmu"),
- BRs({{411, 0.1655}, {421, 0.0666}, {431, 0.0867},
-      {511, 0.2311}, {521, 0.2040}, {531, 0.1918}
-     }){
-    if (need_response_table) MR.init(table_path);
-    else MR.load(table_path);
-
-    HF2mu.readString("Random:setSeed = on");
-    HF2mu.readString("Random:seed = 0");
-    HF2mu.readString("ProcessLevel:all = off");
-    HF2mu.readString("HadronLevel:all = on");
-    HF2mu.readString("HadronLevel:decay = on");
-    HF2mu.init();
-
+ plist(nullptr),
+ MR(std::make_shared<MediumResponse>("Gmu")),
+ plist_grid(-_etamax, _etamax, .2), 
+ HF_grid(-_etamax, _etamax, .2),
+ kernel_Neta(0), kernel_Nphi(0), 
+ kernel_vradial(0.), kernel_pTmin(0.){
+    if (need_response_table) MR->init(table_path);
+    else MR->load(table_path);
 }
 
 JetFinder::JetFinder(int _Neta, int _Nphi, double _etamax)
@@ -136,61 +384,56 @@ JetFinder::JetFinder(int _Neta, int _Nphi, double _etamax)
  phimax(M_PI), phimin(-M_PI), 
  deta((etamax-etamin)/(_Neta-1)), 
  dphi((phimax-phimin)/Nphi),
- MR("Gmu"),
- BRs({{411, 0.1655}, {421, 0.0666}, {431, 0.0867},
-      {511, 0.2311}, {521, 0.2040}, {531, 0.1918}
-     }){
-
-    HF2mu.readString("Random:setSeed = on");
-    HF2mu.readString("Random:seed = 0");
-    HF2mu.readString("ProcessLevel:all = off");
-    HF2mu.readString("HadronLevel:all = on");
-    HF2mu.readString("HadronLevel:decay = on");
-    HF2mu.init();
+ plist(nullptr),
+ MR(std::make_shared<MediumResponse>("Gmu")),
+ plist_grid(-_etamax, _etamax, .2), 
+ HF_grid(-_etamax, _etamax, .2),
+ kernel_Neta(0), kernel_Nphi(0), 
+ kernel_vradial(0.), kernel_pTmin(0.){
+}
+
+JetFinder::JetFinder(int _Neta, int _Nphi, double _etamax, 
+                     std::shared_ptr<MediumResponse> response)
+:Neta(_Neta), Nphi(_Nphi), 
+ etamax(_etamax), etamin(-_etamax), 
+ phimax(M_PI), phimin(-M_PI), 
+ deta((etamax-etamin)/(_Neta-1)), 
+ dphi((phimax-phimin)/Nphi),
+ plist(nullptr),
+ MR(response),
+ plist_grid(-_etamax, _etamax, .2), 
+ HF_grid(-_etamax, _etamax, .2),
+ kernel_Neta(0), kernel_Nphi(0), 
+ kernel_vradial(0.), kernel_pTmin(0.){
 }
 
 void JetFinder::MakeETower(double _vradial, 
                            double _Tfreeze, 
                            double pTmin,
-                           std::vector<particle> _plist, 
-                           std::vector<current> Sources,
+                           const std::vector<particle> & _plist, 
+                           const std::vector<current> & Sources,
                            int coarse_level,
 			   bool charged_jet
 			   ){
     vradial = _vradial;
     Tfreeze = _Tfreeze;
-    plist.clear();
-    plist = _plist;
-    // Initialzie empty towers
-    PT.clear();
-    PT.resize(Neta); 
-    for (auto & it : PT) {
-        it.resize(Nphi);
-        for (auto & iit: it) iit = 0.;
-    }    
-    Pmu.clear();
-    Pmu.resize(Neta); 
+    plist = &_plist;
+    plist_grid.build(_plist);
+    // Reset the towers, the buffers are reused from event to event
     fourvec azero{0., 0., 0., 0.};
-    for (auto & it : Pmu) {
-        it.resize(Nphi);
-        for (auto & iit: it) iit = azero;
-    }    
+    PT.assign(Neta*Nphi, 0.);
+    Pmu.assign(Neta*Nphi, azero);
     // Initialize coarse towerse for medium response contribution
     int coarseNeta = int(Neta/coarse_level), 
         coarseNphi = int(Nphi/coarse_level);    
     double coarsedeta = (etamax-etamin)/(coarseNeta-1); 
     double coarsedphi = (phimax-phimin)/coarseNphi;
-    std::vector<std::vector<std::vector<double> > > coarsePT;
-    coarsePT.resize(2);
-    for (auto & t : coarsePT) {
-       t.resize(coarseNeta); 
-       for (auto & it : t) {
-            it.resize(coarseNphi);
-            for (auto & iit: it) iit = 0.;
-       }
-    }
+    // [ipT][ieta][iphi] -> [(ipT*coarseNeta+ieta)*coarseNphi+iphi]
+    coarsePT.assign(2*coarseNeta*coarseNphi, 0.);
+    double * coarsePT0 = coarsePT.data();
+    double * coarsePT1 = coarsePT.data()+coarseNeta*coarseNphi;
     // put hard particles into the towers
-    for (auto & p : plist){
+    for (auto & p : _plist){
         double eta = p.p.pseudorap();
         double phi = p.p.phi();
         int ieta = corp_index(eta, etamin, etamax, deta, Neta);
@@ -199,13 +442,13 @@ void JetFinder::MakeETower(double _vradial,
 	if (charged_jet){
 	    auto absid = std::abs(p.pid);
 	    if (p.charged || (p.pid==421) ) {
-                Pmu[ieta][iphi] = Pmu[ieta][iphi] + p.p;
-	        if (p.p.xT()>pTmin) PT[ieta][iphi] += p.p.xT();
+                Pmu[ieta*Nphi+iphi] = Pmu[ieta*Nphi+iphi] + p.p;
+	        if (p.p.xT()>pTmin) PT[ieta*Nphi+iphi] += p.p.xT();
 	    }
 	}
 	else {
-            Pmu[ieta][iphi] = Pmu[ieta][iphi] + p.p;
-            if (p.p.xT()>pTmin) PT[ieta][iphi] += p.p.xT();
+            Pmu[ieta*Nphi+iphi] = Pmu[ieta*Nphi+iphi] + p.p;
+            if (p.p.xT()>pTmin) PT[ieta*Nphi+iphi] += p.p.xT();
 	}
     }
     if (Sources.size()==0) return;
@@ -220,29 +463,25 @@ void JetFinder::MakeETower(double _vradial,
         int i = corp_index(s.etas, etamin, etamax, coarsedeta, coarseNeta);
         if (i>=0) clist[i].p = clist[i].p + s.p;
     }
+    // The sources sit on the coarse eta grid, so the response of source j
+    // in tower (ieta, iphi) only depends on (ieta-j, iphi) and the whole
+    // coarse grid is a discrete convolution of the sources with a kernel
+    // that is tabulated once per (vradial, pTmin/Tfreeze).
+    MakeKernel(coarseNeta, coarseNphi, coarsedeta, coarsedphi, pTmin/Tfreeze);
+    double weight = charged_jet ? 2./3. : 1.;
     for (int ieta=0; ieta<coarseNeta; ieta++) {
-        double eta = etamin+ieta*coarsedeta;
         for (int iphi=0; iphi<coarseNphi; iphi++) {
-            double phi = phimin+iphi*coarsedphi;
             double dpT = 0., dpTcut = 0.;
-            for (auto & s: clist){
-                double etas = s.etas;
-                if (charged_jet){
-		    dpT += 2./3.*MR.get_dpT_dydphi(eta-etas, phi, 
-				                   s.p, vradial, 0.);
-                    dpTcut += 2./3.*MR.get_dpT_dydphi(eta-etas, phi, 
-				               s.p, vradial, pTmin/Tfreeze);
-		}
-		else{
-                    dpT += MR.get_dpT_dydphi(eta-etas, phi, 
-                                                   s.p, vradial, 0.);
-                    dpTcut += MR.get_dpT_dydphi(eta-etas, phi, 
-                                               s.p, vradial, pTmin/Tfreeze);
-		}
-
+            for (int j=0; j<coarseNeta; j++){
+                const fourvec & P = clist[j].p;
+                size_t k = 4*((ieta-j+coarseNeta-1)*coarseNphi+iphi);
+                const double * g0 = &kernel[0][k];
+                const double * g1 = &kernel[1][k];
+                dpT += weight*(g0[0]*P.t()+g0[1]*P.x()+g0[2]*P.y()+g0[3]*P.z());
+                dpTcut += weight*(g1[0]*P.t()+g1[1]*P.x()+g1[2]*P.y()+g1[3]*P.z());
             }
-            coarsePT[0][ieta][iphi] = dpT;
-            coarsePT[1][ieta][iphi] = dpTcut;
+            coarsePT0[ieta*coarseNphi+iphi] = dpT;
+            coarsePT1[ieta*coarseNphi+iphi] = dpTcut;
         }
     }
     // Interpolate the coarse grid into the finer grid for jet finding
@@ -264,9 +503,10 @@ void JetFinder::MakeETower(double _vradial,
             double v[2] = {1.-residue2, residue2};
             for (int k1=0; k1<2; k1++){
                 for (int k2=0; k2<2; k2++){
-                    Pmu[ieta][iphi] = Pmu[ieta][iphi] + 
-                                      Nmu0*coarsePT[0][ii+k1][jj+k2]*deta*dphi*u[k1]*v[k2];
-                    PT[ieta][iphi] += coarsePT[1][ii+k1][jj+k2]*deta*dphi*u[k1]*v[k2];
+                    int c = (ii+k1)*coarseNphi+jj+k2;
+                    Pmu[ieta*Nphi+iphi] = Pmu[ieta*Nphi+iphi] + 
+                                          Nmu0*coarsePT0[c]*deta*dphi*u[k1]*v[k2];
+                    PT[ieta*Nphi+iphi] += coarsePT1[c]*deta*dphi*u[k1]*v[k2];
                 }
             }
         }
@@ -276,11 +516,51 @@ void JetFinder::MakeETower(double _vradial,
 
 
 
+void JetFinder::MakeKernel(int coarseNeta, int coarseNphi, 
+                           double coarsedeta, double coarsedphi, double pTmin_over_T){
+    if (kernel_Neta==coarseNeta && kernel_Nphi==coarseNphi 
+        && kernel_vradial==vradial && kernel_pTmin==pTmin_over_T) return;
+    size_t n = (2*coarseNeta-1)*coarseNphi;
+    std::vector<double> raps(n), phis(n);
+    for (int d=-(coarseNeta-1); d<coarseNeta; d++){
+        for (int iphi=0; iphi<coarseNphi; iphi++){
+            size_t k = (d+coarseNeta-1)*coarseNphi+iphi;
+            raps[k] = d*coarsedeta;
+            phis[k] = phimin+iphi*coarsedphi;
+        }
+    }
+    kernel[0].resize(4*n);
+    kernel[1].resize(4*n);
+    MR->get_Gmu(n, raps.data(), phis.data(), vradial, 0., kernel[0].data());
+    MR->get_Gmu(n, raps.data(), phis.data(), vradial, pTmin_over_T, kernel[1].data());
+    kernel_Neta = coarseNeta;
+    kernel_Nphi = coarseNphi;
+    kernel_vradial = vradial;
+    kernel_pTmin = pTmin_over_T;
+}
+
+JetFinder::Stencil JetFinder::MakeStencil(double R) const{
+    Stencil S;
+    int Na = int(std::floor(R/deta));
+    for (int a=-Na; a<=Na; a++){
+        double Rp = std::sqrt(std::max(0., R*R-std::pow(a*deta,2)));
+        // never wrap around the full azimuth
+        int Nb = std::min(int(std::floor(Rp/dphi)), (Nphi-1)/2);
+        S.deta.push_back(a);
+        S.dphi.push_back(Nb);
+    }
+    return S;
+}
+
 void JetFinder::FindJets(std::vector<double> Rs_, 
                          double jetpTMin, 
                          double jetyMin, 
                          double jetyMax,
 			 bool chg_trigger){
+    if (Rs_ != Rs || stencils.size() != Rs_.size()) {
+        stencils.clear();
+        for (auto R : Rs_) stencils.push_back(MakeStencil(R));
+    }
     Rs = Rs_;
     LOG_INFO << "find jet";
     /*LOG_INFO << "trigger by gamma";
@@ -299,9 +579,9 @@ void JetFinder::FindJets(std::vector<double> Rs_,
     Jets.clear();
     HFs.clear();
     std::vector<fastjet::PseudoJet> fjInputs;
-    for (int ieta=0; ieta<Pmu.size(); ieta++) {
-        for (int iphi=0; iphi<Pmu[ieta].size(); iphi++) {
-            auto iit = Pmu[ieta][iphi];
+    for (int ieta=0; ieta<Neta; ieta++) {
+        for (int iphi=0; iphi<Nphi; iphi++) {
+            auto & iit = Pmu[ieta*Nphi+iphi];
             // when we do the first jet finding,
             // only use towers with positive contribution
             if (iit.t()>0.) {
@@ -313,8 +593,11 @@ void JetFinder::FindJets(std::vector<double> Rs_,
     }
 
     fastjet::Selector select_rapidity = fastjet::SelectorRapRange(jetyMin, jetyMax);
+    // the towers are converted once and clustered for each radius;
+    // anti-kt histories of different R can not be shared
     for (int iR=0; iR<Rs.size(); iR++){
 	double jetRadius = Rs[iR];
+	const Stencil & S = stencils[iR];
 	fastjet::JetDefinition jetDef(fastjet::genkt_algorithm, jetRadius, -1);
         fastjet::ClusterSequence clustSeq(fjInputs, jetDef);
         std::vector<fastjet::PseudoJet> AllJets = clustSeq.inclusive_jets(jetpTMin);
@@ -330,16 +613,17 @@ void JetFinder::FindJets(std::vector<double> Rs_,
               double Jphi = jetP.phi();
 	      //LOG_INFO << Jphi << " +++" << std::endl;
               double Jeta = jetP.pseudorap();
-              for (double eta=Jeta-jetRadius; eta<=Jeta+jetRadius; eta+=deta){
-                int ieta = corp_index(eta, etamin, etamax, deta, Neta);
-                if (ieta<0) continue;
-                double Rp = std::sqrt(1e-9+std::pow(jetRadius,2)-std::pow(Jeta-eta,2)); 
-                for (double phi=Jphi-Rp; phi<=Jphi+Rp; phi+=dphi){
-                    double newphi = phi;
-                    if (phi<-M_PI) newphi+=2*M_PI;
-                    if (phi>M_PI) newphi-=2*M_PI;
-                    int iphi = corp_index(newphi, phimin, phimax, dphi, Nphi);
-                    newP = newP + Pmu[ieta][iphi];
+              // sum the towers of the stencil around the tower of the axis
+              int Jieta = corp_index(Jeta, etamin, etamax, deta, Neta);
+              int Jiphi = corp_index(Jphi, phimin, phimax, dphi, Nphi);
+              if (Jieta<0 || Jiphi<0) continue;
+              for (size_t a=0; a<S.deta.size(); a++){
+                int ieta = Jieta+S.deta[a];
+                if (ieta<0 || ieta>=Neta) continue;
+                const fourvec * row = Pmu.data()+ieta*Nphi;
+                for (int b=-S.dphi[a]; b<=S.dphi[a]; b++){
+                    int iphi = ((Jiphi+b)%Nphi+Nphi)%Nphi;
+                    newP = newP + row[iphi];
                 }  
               }
             J.pmu = newP;
@@ -371,7 +655,7 @@ void JetFinder::FindJets(std::vector<double> Rs_,
 }
 
 
-void JetFinder::FindHF(std::vector<particle> plist) {
+void JetFinder::FindHF(const std::vector<particle> & plist) {
     // find heavy meson, decay it until it produce a muon (weighted by branching ratio)
     // the candidate contains the HF meson and its decay product
     for (auto & pIn : plist){
@@ -379,33 +663,39 @@ void JetFinder::FindHF(std::vector<particle> plist) {
         bool isHF = (pIn.pid==421);
         if (isHF) HFs.push_back(pIn);
     }
+    HF_grid.build(HFs);
 }
 
 void JetFinder::CalcJetshape(std::vector<double> rbins){
+    // the (eta, phi) lattice around the jet axis starts at Jeta-3 and
+    // Jphi-Rp; only the part of it within the last radial bin is visited
+    double Rmax = std::min(3., rbins.back());
     for (auto & J : Jets){
         double Jphi = J.phi;
         double Jeta = J.eta;
         J.shape.resize(rbins.size()-1);
         for (auto & it : J.shape) it = 0.;
-        for (double eta=Jeta-3.; eta<=Jeta+3.; eta+=deta){
+        int a0 = std::max(0, int(std::floor((3.-Rmax)/deta)));
+        int Na = int(std::floor(6./deta));
+        for (int a=a0; a<=Na; a++){
+            double eta = Jeta-3.+a*deta;
+            if (eta-Jeta > Rmax) break;
             int ieta = corp_index(eta, etamin, etamax, deta, Neta);
             if (ieta<0) continue;
             double Rp = std::sqrt(1e-9+std::pow(3.,2)-std::pow(Jeta-eta,2) ); 
-            for (double phi=Jphi-Rp; phi<=Jphi+Rp; phi+=dphi){
+            int b0 = std::max(0, int(std::floor((Rp-Rmax)/dphi)));
+            int Nb = int(std::floor(2.*Rp/dphi));
+            for (int b=b0; b<=Nb; b++){
+                double phi = Jphi-Rp+b*dphi;
+                if (phi-Jphi > Rmax) break;
                 double dist = std::sqrt(std::pow(Jeta-eta,2) + std::pow(Jphi-phi,2));
-                int index = -1;
-                for (int i=0; i<J.shape.size(); i++){
-                    if (dist>=rbins[i] && dist<rbins[i+1]) {
-                        index = i;
-                        break;
-                    }
-                }
+                int index = bin_index_left_closed(rbins, dist);
                 if (index==-1) continue;
                 double newphi = phi;
                 if (phi<-M_PI) newphi+=2*M_PI;
                 if (phi>M_PI) newphi-=2*M_PI;
                 int iphi = corp_index(newphi, phimin, phimax, dphi, Nphi);
-                J.shape[index] += PT[ieta][iphi];
+                J.shape[index] += PT[ieta*Nphi+iphi];
             }  
         }
         for (int i=0; i<J.shape.size(); i++) 
@@ -414,6 +704,7 @@ void JetFinder::CalcJetshape(std::vector<double> rbins){
 }
 
 void JetFinder::Frag(std::vector<double> zbins, std::vector<double> zpTbins){
+    std::vector<size_t> nearby;
     for (int i=0; i<Jets.size(); i++){
 	auto & J = Jets[i];
         double Jphi = J.phi;
@@ -423,7 +714,9 @@ void JetFinder::Frag(std::vector<double> zbins, std::vector<double> zpTbins){
         J.dNdpT.resize(zpTbins.size()-1);
         for (auto & it : J.dNdpT) it = 0.;
 
-	for (auto & p : plist) {
+	plist_grid.query(Jeta, Jphi, J.R, nearby);
+	for (auto k : nearby) {
+	    auto & p = (*plist)[k];
 	    double absdphi = std::abs(Jphi - p.p.phi());
             if (absdphi>M_PI) absdphi = 2.*M_PI-absdphi;
             double deta = Jeta-p.p.pseudorap();
@@ -431,25 +724,13 @@ void JetFinder::Frag(std::vector<double> zbins, std::vector<double> zpTbins){
 	    // D(z)
             if (dR<J.R && p.charged) {
                 double z = std::min(p.p.xT()*std::cos(dR)/J.pT,.999);
-                int index = -1;
-                for (int i=0; i<J.dNdz.size(); i++){
-                    if (z>zbins[i] && z<=zbins[i+1]) {
-                        index = i;
-                        break;
-                    }
-                }
+                int index = bin_index_right_closed(zbins, z);
 		if (index >= 0) J.dNdz[index] += 1.;
             }
 	    // DpT
             if (dR<J.R && p.charged) {
                 double pT = p.p.xT();
-                int index = -1;
-                for (int i=0; i<J.dNdpT.size(); i++){
-                    if (pT>zpTbins[i] && pT<=zpTbins[i+1]) {
-                        index = i;
-                        break;
-                    }
-                }
+                int index = bin_index_right_closed(zpTbins, pT);
                 if (index >= 0) J.dNdpT[index] += 1.;
             } 
         }
@@ -469,9 +750,9 @@ void JetFinder::Frag(std::vector<double> zbins, std::vector<double> zpTbins){
                         double pTl = zbins[i]*J.pT/std::cos(dR);
 			double pTh = zbins[i+1]*J.pT/std::cos(dR);
 			if(pTh/Tfreeze<30.){
-                        double Yield_l = MR.get_dpT_dydphi(eta-etas, newphi, 
+                        double Yield_l = MR->get_dpT_dydphi(eta-etas, newphi, 
 				    s.p,vradial, pTl/Tfreeze);
-                        double Yield_h = MR.get_dpT_dydphi(eta-etas, newphi,
+                        double Yield_h = MR->get_dpT_dydphi(eta-etas, newphi,
                                     s.p,vradial, pTh/Tfreeze);
 		  	J.dNdz[i] += 2./3.*(Yield_l-Yield_h)
 				       /((pTh+pTl)/2.)
@@ -483,9 +764,9 @@ void JetFinder::Frag(std::vector<double> zbins, std::vector<double> zpTbins){
                         double pTl = zpTbins[i];
                         double pTh = zpTbins[i+1];
                         if(pTh/Tfreeze<30.){
-                        double Yield_l = MR.get_dpT_dydphi(eta-etas, newphi,
+                        double Yield_l = MR->get_dpT_dydphi(eta-etas, newphi,
                                     s.p,vradial, pTl/Tfreeze);
-                        double Yield_h = MR.get_dpT_dydphi(eta-etas, newphi,
+                        double Yield_h = MR->get_dpT_dydphi(eta-etas, newphi,
                                     s.p,vradial, pTh/Tfreeze);
                         J.dNdpT[i] += 2./3.*(Yield_l-Yield_h)
                                        *.1*.1;
@@ -517,7 +798,9 @@ void JetFinder::Frag(std::vector<double> zbins, std::vector<double> zpTbins){
             J.dBdz.resize(zbins.size()-1);
             for (auto & it : J.dDdz) it = 0.;
             for (auto & it : J.dBdz) it = 0.;
-            for (auto & hf : HFs) {
+            HF_grid.query(Jeta, Jphi, thisR, nearby);
+            for (auto k : nearby) {
+                auto & hf = HFs[k];
                 if (hf.is_virtual) continue;
             
                 double absdphi = std::abs(Jphi - hf.p.phi());
@@ -534,13 +817,7 @@ void JetFinder::Frag(std::vector<double> zbins, std::vector<double> zpTbins){
         	    hf.is_virtual = true;
                     //double z = (hf.p.x()*J.pmu.x()+hf.p.y()*J.pmu.y()+hf.p.z()*J.pmu.z())/(J.pmu.x()*J.pmu.x()+J.pmu.y()*J.pmu.y()+J.pmu.z()*J.pmu.z());
                     double z = hf.p.xT()*std::cos(dR_hf_J)/J.pT;
-		    int index = -1;
-                    for (int i=0; i<J.dDdz.size(); i++){
-                        if (z>zbins[i] && z<=zbins[i+1]) {
-                            index = i;
-                            break;
-                        }
-                    }
+		    int index = bin_index_right_closed(zbins, z);
                     
                     // some exp cuts of ALICE:
                     bool cuts = (5<J.pT && J.pT<7 && 2<hf.p.xT() && hf.p.xT() < 7) ||
@@ -554,13 +831,7 @@ void JetFinder::Frag(std::vector<double> zbins, std::vector<double> zpTbins){
                 if ((dR_hf_J < thisR) && isB && J.flavor==5) {
 	            hf.is_virtual = true;
                     double z = hf.p.xT()*std::cos(dR_hf_J)/J.pT;
-                    int index = -1;
-                    for (int i=0; i<J.dBdz.size(); i++){ 
-                        if (z>zbins[i] && z<=zbins[i+1]) {
-                            index = i;
-                            break;
-                        }
-                    }
+                    int index = bin_index_right_closed(zbins, z);
                     if (index >= 0) J.dBdz[index] += 1.;
                 }
 
@@ -575,6 +846,7 @@ void JetFinder::Frag(std::vector<double> zbins, std::vector<double> zpTbins){
 
 
 void JetFinder::LabelFlavor(){
+    std::vector<size_t> nearby;
     // label all HF as real
     for (int i=0; i<Rs.size(); i++){
 	    double thisR = Rs[i];
@@ -588,7 +860,10 @@ void JetFinder::LabelFlavor(){
         double Jeta = J.eta;
         bool isD = false;
         bool isB = false;
-        for (auto & hf : HFs){
+        // candidates are visited in the order of HFs
+        HF_grid.query(Jeta, Jphi, thisR, nearby);
+        for (auto k : nearby){
+            auto & hf = HFs[k];
             double absdphi = std::abs(Jphi - hf.p.phi());
             if (absdphi>M_PI) absdphi = 2.*M_PI-absdphi;
             double deta = Jeta-hf.p.pseudorap();
@@ -615,67 +890,29 @@ void JetFinder::LabelFlavor(){
 LeadingParton::LeadingParton():
 pTbins({1,2,3,4,5,6,8,10,12,16,20,24,30,40,50,60,80,100,120,150,200,300,500}){
     NpT = pTbins.size()-1;
-    nchg.resize(NpT); for (auto & it:nchg) it=0.;
-    npi.resize(NpT); for (auto & it:npi) it=0.;
-    nstrange.resize(NpT); for (auto & it:nstrange) it=0.;
-    nD.resize(NpT); for (auto & it:nD) it=0.;
-    nB.resize(NpT); for (auto & it:nB) it=0.;
-    v2chg.resize(NpT); 
-    for (auto & it:v2chg) {
-        it.resize(2);
-        for (auto & iit : it) iit=0.;
-    }
-    v3chg.resize(NpT); 
-    for (auto & it:v3chg) {
-        it.resize(2);
-        for (auto & iit : it) iit=0.;
-    }
-    v2pi.resize(NpT); 
-    for (auto & it:v2pi) {
-        it.resize(2);
-        for (auto & iit : it) iit=0.;
-    }
-    v3pi.resize(NpT); 
-    for (auto & it:v3pi) {
-        it.resize(2);
-        for (auto & iit : it) iit=0.;
-    }
-    v2strange.resize(NpT); 
-    for (auto & it:v2strange) {
-        it.resize(2);
-        for (auto & iit : it) iit=0.;
-    }
-    v3strange.resize(NpT); 
-    for (auto & it:v3strange) {
-        it.resize(2);
-        for (auto & iit : it) iit=0.;
-    }
-    v2D.resize(NpT); 
-    for (auto & it:v2D) {
-        it.resize(2);
-        for (auto & iit : it) iit=0.;
-    }
-    v3D.resize(NpT); 
-    for (auto & it:v3D) {
-        it.resize(2);
-        for (auto & iit : it) iit=0.;
-    }
-    v2B.resize(NpT); 
-    for (auto & it:v2B) {
-        it.resize(2);
-        for (auto & iit : it) iit=0.;
-    }
-    v3B.resize(NpT); 
-    for (auto & it:v3B) {
-        it.resize(2);
-        for (auto & iit : it) iit=0.;
-    }
+    HistAxis pT(pTbins);
+    nchg = Histogram(pT);
+    npi = Histogram(pT);
+    nstrange = Histogram(pT);
+    nD = Histogram(pT);
+    nB = Histogram(pT);
+    // Q-vectors, component 0 (1) holds the cos (sin) part
+    v2chg = Histogram(pT, 2);
+    v3chg = Histogram(pT, 2);
+    v2pi = Histogram(pT, 2);
+    v3pi = Histogram(pT, 2);
+    v2strange = Histogram(pT, 2);
+    v3strange = Histogram(pT, 2);
+    v2D = Histogram(pT, 2);
+    v3D = Histogram(pT, 2);
+    v2B = Histogram(pT, 2);
+    v3B = Histogram(pT, 2);
 
     binwidth.resize(NpT); 
     for (int i=0; i<NpT; i++) 
         binwidth[i]=pTbins[i+1]-pTbins[i];
 }
-void LeadingParton::add_event(std::vector<particle> plist, 
+void LeadingParton::add_event(const std::vector<particle> & plist, 
                             double sigma_gen){
     for (auto & p : plist){
         {
@@ -692,48 +929,42 @@ void LeadingParton::add_event(std::vector<particle> plist,
             bool ischg = (pid==211 || pid==321 || pid==2212) && (std::abs(p.p.pseudorap()) < 1.) ;
             bool isD = (pid==411 || pid == 421 || pid == 413 || pid == 423) && (std::abs(p.p.rap()) < 1.) ;
             bool isB = (pid==511 || pid == 521 || pid == 513  || pid == 523) && (std::abs(p.p.rap()) < 2.4) ;
-            int ii=0;
-            for (int i=0; i<NpT; i++){
-                if ( (pTbins[i]<pT) && (pT<pTbins[i+1]) ) {
-                    ii = i;
-                    break;
-                }
-            }
-            if (ii==NpT) ii=NpT-1;
+            // hadrons outside of the pT range are counted in the first bin
+            int ii = std::max(nchg.xaxis().find(pT), 0);
             if (ispi) {
-                npi[ii] += sigma_gen;
-                v2pi[ii][0] += sigma_gen*std::cos(2*p.p.phi());
-                v2pi[ii][1] += sigma_gen*std::sin(2*p.p.phi());
-                v3pi[ii][0] += sigma_gen*std::cos(3*p.p.phi());
-                v3pi[ii][1] += sigma_gen*std::sin(3*p.p.phi());
+                npi.fill(ii, sigma_gen);
+                v2pi.fill(v2pi.index(ii, 0, 0), sigma_gen*std::cos(2*p.p.phi()));
+                v2pi.fill(v2pi.index(ii, 0, 1), sigma_gen*std::sin(2*p.p.phi()));
+                v3pi.fill(v3pi.index(ii, 0, 0), sigma_gen*std::cos(3*p.p.phi()));
+                v3pi.fill(v3pi.index(ii, 0, 1), sigma_gen*std::sin(3*p.p.phi()));
             }
             if (ischg){
-                nchg[ii] += sigma_gen;
-                v2chg[ii][0] += sigma_gen*std::cos(2*p.p.phi());
-                v2chg[ii][1] += sigma_gen*std::sin(2*p.p.phi());
-                v3chg[ii][0] += sigma_gen*std::cos(3*p.p.phi());
-                v3chg[ii][1] += sigma_gen*std::sin(3*p.p.phi());
+                nchg.fill(ii, sigma_gen);
+                v2chg.fill(v2chg.index(ii, 0, 0), sigma_gen*std::cos(2*p.p.phi()));
+                v2chg.fill(v2chg.index(ii, 0, 1), sigma_gen*std::sin(2*p.p.phi()));
+                v3chg.fill(v3chg.index(ii, 0, 0), sigma_gen*std::cos(3*p.p.phi()));
+                v3chg.fill(v3chg.index(ii, 0, 1), sigma_gen*std::sin(3*p.p.phi()));
             }
             if (isstrange){
-                nstrange[ii] += sigma_gen;
-                v2strange[ii][0] += sigma_gen*std::cos(2*p.p.phi());
-                v2strange[ii][1] += sigma_gen*std::sin(2*p.p.phi());
-                v3strange[ii][0] += sigma_gen*std::cos(3*p.p.phi());
-                v3strange[ii][1] += sigma_gen*std::sin(3*p.p.phi());
+                nstrange.fill(ii, sigma_gen);
+                v2strange.fill(v2strange.index(ii, 0, 0), sigma_gen*std::cos(2*p.p.phi()));
+                v2strange.fill(v2strange.index(ii, 0, 1), sigma_gen*std::sin(2*p.p.phi()));
+                v3strange.fill(v3strange.index(ii, 0, 0), sigma_gen*std::cos(3*p.p.phi()));
+                v3strange.fill(v3strange.index(ii, 0, 1), sigma_gen*std::sin(3*p.p.phi()));
             }
             if (isD) {
-                nD[ii] += sigma_gen;
-                v2D[ii][0] += sigma_gen*std::cos(2*p.p.phi());
-                v2D[ii][1] += sigma_gen*std::sin(2*p.p.phi());
-                v3D[ii][0] += sigma_gen*std::cos(3*p.p.phi());
-                v3D[ii][1] += sigma_gen*std::sin(3*p.p.phi());
+                nD.fill(ii, sigma_gen);
+                v2D.fill(v2D.index(ii, 0, 0), sigma_gen*std::cos(2*p.p.phi()));
+                v2D.fill(v2D.index(ii, 0, 1), sigma_gen*std::sin(2*p.p.phi()));
+                v3D.fill(v3D.index(ii, 0, 0), sigma_gen*std::cos(3*p.p.phi()));
+                v3D.fill(v3D.index(ii, 0, 1), sigma_gen*std::sin(3*p.p.phi()));
             }
             if (isB) {
-                nB[ii] += sigma_gen;
-                v2B[ii][0] += sigma_gen*std::cos(2*p.p.phi());
-                v2B[ii][1] += sigma_gen*std::sin(2*p.p.phi());
-                v3B[ii][0] += sigma_gen*std::cos(3*p.p.phi());
-                v3B[ii][1] += sigma_gen*std::sin(3*p.p.phi());
+                nB.fill(ii, sigma_gen);
+                v2B.fill(v2B.index(ii, 0, 0), sigma_gen*std::cos(2*p.p.phi()));
+                v2B.fill(v2B.index(ii, 0, 1), sigma_gen*std::sin(2*p.p.phi()));
+                v3B.fill(v3B.index(ii, 0, 0), sigma_gen*std::cos(3*p.p.phi()));
+                v3B.fill(v3B.index(ii, 0, 1), sigma_gen*std::sin(3*p.p.phi()));
             }
         }
     }
@@ -747,10 +978,10 @@ void LeadingParton::write(std::string fheader){
         f    << (pTbins[i]+pTbins[i+1])/2. << " "
              << pTbins[i] << " "
              << pTbins[i+1] << " "
-             << nchg[i]/binwidth[i] << " "
-             << npi[i]/binwidth[i] << " "
-             << nD[i]/binwidth[i] << " "
-             << nB[i]/binwidth[i] << std::endl;
+             << nchg.sumw(i)/binwidth[i] << " "
+             << npi.sumw(i)/binwidth[i] << " "
+             << nD.sumw(i)/binwidth[i] << " "
+             << nB.sumw(i)/binwidth[i] << std::endl;
     }
     f.close();
 
@@ -762,21 +993,21 @@ void LeadingParton::write(std::string fheader){
         f2   << (pTbins[i]+pTbins[i+1])/2. << " "
              << pTbins[i] << " "
              << pTbins[i+1] << " "
-             << nchg[i] << " " 
-             << v2chg[i][0] << " " << v2chg[i][1] << " "
-             << v3chg[i][0] << " " << v3chg[i][1] << " "
-             << npi[i] << " " 
-             << v2pi[i][0] << " " << v2pi[i][1] << " "
-             << v3pi[i][0] << " " << v3pi[i][1] << " "
-             << nstrange[i] << " "
-             << v2strange[i][0] << " " << v2strange[i][1] << " "
-             << v3strange[i][0] << " " << v3strange[i][1] << " "
-             << nD[i] << " " 
-             << v2D[i][0] << " " << v2D[i][1] << " "
-             << v3D[i][0] << " " << v3D[i][1] << " "
-             << nB[i] << " " 
-             << v2B[i][0] << " " << v2B[i][1] << " "
-             << v3B[i][0] << " " << v3B[i][1] << std::endl;
+             << nchg.sumw(i) << " " 
+             << v2chg.sumw(v2chg.index(i, 0, 0)) << " " << v2chg.sumw(v2chg.index(i, 0, 1)) << " "
+             << v3chg.sumw(v3chg.index(i, 0, 0)) << " " << v3chg.sumw(v3chg.index(i, 0, 1)) << " "
+             << npi.sumw(i) << " " 
+             << v2pi.sumw(v2pi.index(i, 0, 0)) << " " << v2pi.sumw(v2pi.index(i, 0, 1)) << " "
+             << v3pi.sumw(v3pi.index(i, 0, 0)) << " " << v3pi.sumw(v3pi.index(i, 0, 1)) << " "
+             << nstrange.sumw(i) << " "
+             << v2strange.sumw(v2strange.index(i, 0, 0)) << " " << v2strange.sumw(v2strange.index(i, 0, 1)) << " "
+             << v3strange.sumw(v3strange.index(i, 0, 0)) << " " << v3strange.sumw(v3strange.index(i, 0, 1)) << " "
+             << nD.sumw(i) << " " 
+             << v2D.sumw(v2D.index(i, 0, 0)) << " " << v2D.sumw(v2D.index(i, 0, 1)) << " "
+             << v3D.sumw(v3D.index(i, 0, 0)) << " " << v3D.sumw(v3D.index(i, 0, 1)) << " "
+             << nB.sumw(i) << " " 
+             << v2B.sumw(v2B.index(i, 0, 0)) << " " << v2B.sumw(v2B.index(i, 0, 1)) << " "
+             << v3B.sumw(v3B.index(i, 0, 0)) << " " << v3B.sumw(v3B.index(i, 0, 1)) << std::endl;
     }
     f2.close();*/
 }
@@ -803,159 +1034,53 @@ xJbins({0, .05,  .1, .15,  .2,
           .5, .55,  .6, .65,  .7,
          .75,  .8, .85,  .9, .95, 1.0})
 { 
-
-    xJ_W.resize(xJ_pTbins.size()-1);
-    for (auto & it: xJ_W) it = 0.;
-    xJ.resize(xJ_pTbins.size()-1);
-    for (auto & it: xJ) {
-        it.resize(xJbins.size()-1);
-        for (auto & iit : it) iit = 0.;
-    }
     NpT = pTbins.size()-1;
-    leading_yield.resize(NpT);
-    subleading_yield.resize(NpT);
-    for (auto & it : leading_yield) it=0.;
-    for (auto & it : subleading_yield) it=0.;
     shape_NpT = shape_pTbins.size()-1;
     shape_Nr = shape_rbins.size()-1;
-
-    Frags.resize(Frag_pTbins.size()-1);
-    Frags_pT.resize(Frag_pTbins.size()-1);
-    Frags_W.resize(Frag_pTbins.size()-1);
-    Frags_D.resize(Frag_pTbins.size()-1);
-    Frags_D_pT.resize(Frag_pTbins.size()-1);
-    Frags_D_W.resize(Frag_pTbins.size()-1);
-    Frags_B.resize(Frag_pTbins.size()-1);
-    Frags_B_pT.resize(Frag_pTbins.size()-1);
-    Frags_B_W.resize(Frag_pTbins.size()-1);
-
-    D_in_jet_W.resize(Rs.size());
-    for (auto & it: D_in_jet_W) {
-        it.resize(Frag_pTbins.size()-1);
-        for (auto & iit : it) iit = 0.;
-    }
-    
-    B_in_jet_W.resize(Rs.size());
-    for (auto & it: B_in_jet_W) {
-        it.resize(Frag_pTbins.size()-1);
-	for (auto & iit : it) iit = 0.;
-    }
-
-    D_in_jet.resize(Rs.size());
-    for (auto & it: D_in_jet){
-	it.resize(Frag_pTbins.size()-1);
-        for (auto & iit : it) {
-            iit.resize(Frag_zbins.size()-1);
-	    for (auto & iiit : iit) iiit=0.;
-	}
-    }
-
-    B_in_jet.resize(Rs.size());
-    for (auto & it: B_in_jet){
-        it.resize(Frag_pTbins.size()-1);
-        for (auto & iit : it) {
-            iit.resize(Frag_zbins.size()-1);
-            for (auto & iiit : iit) iiit=0.;
-        }
-    }
-
-
-
-    for (auto & it : Frags_W) it=0.;
-    for (auto & it : Frags) {
-        it.resize(Frag_zbins.size()-1);
-	for (auto & itt : it) itt =0.;
-    }
-    for (auto & it : Frags_pT) {
-        it.resize(Frag_zpTbins.size()-1);
-        for (auto & itt : it) itt =0.;
-    }
-
-    for (auto & it : Frags_D_W) it=0.;
-    for (auto & it : Frags_D) {
-        it.resize(Frag_zbins.size()-1);
-        for (auto & itt : it) itt =0.;
-    }
-    for (auto & it : Frags_D_pT) {
-        it.resize(Frag_zpTbins.size()-1);
-        for (auto & itt : it) itt =0.;
-    }
-
-    for (auto & it : Frags_B_W) it=0.;
-    for (auto & it : Frags_B) {
-        it.resize(Frag_zbins.size()-1);
-        for (auto & itt : it) itt =0.;
-    }
-    for (auto & it : Frags_B_pT) {
-        it.resize(Frag_zpTbins.size()-1);
-        for (auto & itt : it) itt =0.;
-    }
-
-
-    Shape_W.resize(shape_NpT); for (auto & it: Shape_W) it=0.;
-    shapes.resize(shape_NpT); 
-    for (auto & it:shapes) {
-        it.resize(_shape_rbins.size()-1);
-        for (auto & iit : it ) iit=0.;
-    }
-    Shape_D_W.resize(shape_NpT); for (auto & it: Shape_D_W) it=0.;
-    Dshapes.resize(shape_NpT); 
-    for (auto & it:Dshapes) {
-        it.resize(_shape_rbins.size()-1);
-        for (auto & iit : it ) iit=0.;
-    }
-    Shape_B_W.resize(shape_NpT); for (auto & it: Shape_B_W) it=0.;
-    Bshapes.resize(shape_NpT); 
-    for (auto & it:Bshapes) {
-        it.resize(_shape_rbins.size()-1);
-        for (auto & iit : it ) iit=0.;
-    }
-    dsigmadpT.resize(Rs.size());
-    for (auto & it:dsigmadpT) {
-            it.resize(NpT);
-        for (auto & iit : it ) iit=0.;
-    }
-    dDdpT.resize(Rs.size());
-    for (auto & it:dDdpT) {
-            it.resize(NpT);
-        for (auto & iit : it ) iit=0.;
-    }
-    dBdpT.resize(Rs.size());
-    for (auto & it:dBdpT) {
-            it.resize(NpT);
-        for (auto & iit : it ) iit=0.;
-    }
-    JQ2.resize(Rs.size());
-    for (auto & it:JQ2) {
-        it.resize(NpT);
-        for (auto & iit : it ){
-            iit.resize(2);
-            iit[0] = 0.; iit[1] = 0.;
-        }
-    }
-    JQ3.resize(Rs.size());
-    for (auto & it:JQ3) {
-        it.resize(NpT);
-        for (auto & iit : it ){
-            iit.resize(2);
-            iit[0] = 0.; iit[1] = 0.;
-        }
-    }
-    JQ4.resize(Rs.size());
-    for (auto & it:JQ4) {
-        it.resize(NpT);
-        for (auto & iit : it ){
-            iit.resize(2);
-            iit[0] = 0.; iit[1] = 0.;
-        }
-    }
+    HistAxis pT(pTbins), xJ_pT(xJ_pTbins), shape_pT(shape_pTbins), 
+             Frag_pT(Frag_pTbins);
+
+    xJ_W = Histogram(xJ_pT);
+    xJ = Histogram(xJ_pT, HistAxis(xJbins));
+    leading_yield = Histogram(pT);
+    subleading_yield = Histogram(pT);
+
+    Frags_W = Histogram(Frag_pT);
+    Frags = Histogram(Frag_pT, HistAxis(Frag_zbins));
+    Frags_pT = Histogram(Frag_pT, HistAxis(Frag_zpTbins));
+    Frags_D_W = Frags_W;
+    Frags_D = Frags;
+    Frags_D_pT = Frags_pT;
+    Frags_B_W = Frags_W;
+    Frags_B = Frags;
+    Frags_B_pT = Frags_pT;
+
+    Shape_W = Histogram(shape_pT);
+    shapes = Histogram(shape_pT, HistAxis(shape_rbins));
+    Shape_D_W = Shape_W;
+    Dshapes = shapes;
+    Shape_B_W = Shape_W;
+    Bshapes = shapes;
+
+    // one histogram per jet radius
+    D_in_jet_W.assign(Rs.size(), Histogram(Frag_pT));
+    B_in_jet_W.assign(Rs.size(), Histogram(Frag_pT));
+    D_in_jet.assign(Rs.size(), Histogram(Frag_pT, HistAxis(Frag_zbins)));
+    B_in_jet.assign(Rs.size(), Histogram(Frag_pT, HistAxis(Frag_zbins)));
+    dsigmadpT.assign(Rs.size(), Histogram(pT));
+    dDdpT.assign(Rs.size(), Histogram(pT));
+    dBdpT.assign(Rs.size(), Histogram(pT));
+    // Q-vectors, component 0 (1) holds the cos (sin) part
+    JQ2.assign(Rs.size(), Histogram(pT, 2));
+    JQ3.assign(Rs.size(), Histogram(pT, 2));
+    JQ4.assign(Rs.size(), Histogram(pT, 2));
 
     binwidth.resize(NpT);
     for (int i=0; i<NpT; i++)
         binwidth[i]=pTbins[i+1]-pTbins[i];
 }
 //std::ofstream  fdijet("dijet-lowpT.dat");
-void JetStatistics::add_event(std::vector<Fjet> jets, double sigma_gen, fourvec x0){
+void JetStatistics::add_event(const std::vector<Fjet> & jets, double sigma_gen, const fourvec & x0){
     // di-jet asymmetry
     /*std::vector<Fjet> jjs;
     for (auto & J:jets){
@@ -974,54 +1099,34 @@ void JetStatistics::add_event(std::vector<Fjet> jets, double sigma_gen, fourvec
 	    double x = j2.pT/j1.pT;
             if ((std::cos(dphi) < std::cos(7./8.*M_PI)) && (x>0.32)) {
 	        // back-to-back dijets
-		int pTindex = -1;
-                for (int i=0; i<xJ_pTbins.size()-1; i++){
-                    if (xJ_pTbins[i]<j1.pT && j1.pT< xJ_pTbins[i+1]) {
-                        pTindex = i;
-                        break;
-                    }
-                }
+		int pTindex = xJ.xaxis().find(j1.pT);
 		if (pTindex>=0) {
-                    int rindex = -1;
-                    for (int i=0; i<xJbins.size()-1; i++){
-                        if (xJbins[i]<x && x < xJbins[i+1]) {
-                            rindex = i; 
-                            break;
-                        }
-                    }
+                    int rindex = xJ.yaxis().find(x);
 		    if (rindex>=0){
-                        xJ[pTindex][rindex] += sigma_gen;
-                        xJ_W[pTindex] += sigma_gen;
+                        xJ.fill(xJ.index(pTindex, rindex), sigma_gen);
+                        xJ_W.fill(pTindex, sigma_gen);
                     }
 		}
                 // leading/subleading jet yield
-		for (int i=0; i<pTbins.size()-1; i++){
-                     if (pTbins[i]<j1.pT && j1.pT< pTbins[i+1])
-		        leading_yield[i] += sigma_gen;
-	             if (pTbins[i]<j2.pT && j2.pT< pTbins[i+1])
-                        subleading_yield[i] += sigma_gen;
-		}
+                int i1 = leading_yield.xaxis().find(j1.pT),
+                    i2 = subleading_yield.xaxis().find(j2.pT);
+                if (i1>=0) leading_yield.fill(i1, sigma_gen);
+                if (i2>=0) subleading_yield.fill(i2, sigma_gen);
             }
         }
     }
     // shape
     for (auto & J:jets){
         if ((J.R<0.41) && (J.R>0.39) && (std::abs(J.eta) < 2.0) ) {
-            int ii=-1;
-            for (int i=0; i<shape_NpT; i++){
-                if ((shape_pTbins[i]<J.pT) && (J.pT<shape_pTbins[i+1])) {
-                    ii = i;
-                    break;
-                }
-            }
+            int ii = shapes.xaxis().find(J.pT);
             if (ii<0) continue;
-	    if (J.flavor==4) Shape_D_W[ii] += sigma_gen;
-	    if (J.flavor==5) Shape_B_W[ii] += sigma_gen;
-	    Shape_W[ii] += sigma_gen;
+	    if (J.flavor==4) Shape_D_W.fill(ii, sigma_gen);
+	    if (J.flavor==5) Shape_B_W.fill(ii, sigma_gen);
+	    Shape_W.fill(ii, sigma_gen);
             for (int i=0; i<shape_Nr; i++){
-                shapes[ii][i] += sigma_gen*J.shape[i];
-                if (J.flavor==4) Dshapes[ii][i] += sigma_gen*J.shape[i];
-                if (J.flavor==5) Bshapes[ii][i] += sigma_gen*J.shape[i];
+                shapes.fill(shapes.index(ii, i), sigma_gen*J.shape[i]);
+                if (J.flavor==4) Dshapes.fill(Dshapes.index(ii, i), sigma_gen*J.shape[i]);
+                if (J.flavor==5) Bshapes.fill(Bshapes.index(ii, i), sigma_gen*J.shape[i]);
             }
         }
     }
@@ -1043,26 +1148,20 @@ void JetStatistics::add_event(std::vector<Fjet> jets, double sigma_gen, fourvec
                 if ((dR<1.0) && (J2.pT>J.pT)) triggered = false;
             }
             if (!triggered) continue;	
-            int ii=-1;
-            for (int i=0; i<Frag_pTbins.size()-1; i++){
-                if ((Frag_pTbins[i]<J.pT) && (J.pT<Frag_pTbins[i+1])) {
-                    ii = i;
-                    break;
-                }
-            }
+            int ii = Frags.xaxis().find(J.pT);
             if (ii<0) continue;
-	    if (J.flavor==4) Frags_D_W[ii] += sigma_gen;
-	    if (J.flavor==5) Frags_B_W[ii] += sigma_gen;
-	    Frags_W[ii] += sigma_gen;
-            for (int j=0; j<Frags[ii].size(); j++){
-                if (J.flavor==4) Frags_D[ii][j] += sigma_gen*J.dNdz[j];
-		if (J.flavor==5) Frags_B[ii][j] += sigma_gen*J.dNdz[j];
-		Frags[ii][j] += sigma_gen*J.dNdz[j];
+	    if (J.flavor==4) Frags_D_W.fill(ii, sigma_gen);
+	    if (J.flavor==5) Frags_B_W.fill(ii, sigma_gen);
+	    Frags_W.fill(ii, sigma_gen);
+            for (int j=0; j<Frags.ny(); j++){
+                if (J.flavor==4) Frags_D.fill(Frags_D.index(ii, j), sigma_gen*J.dNdz[j]);
+		if (J.flavor==5) Frags_B.fill(Frags_B.index(ii, j), sigma_gen*J.dNdz[j]);
+		Frags.fill(Frags.index(ii, j), sigma_gen*J.dNdz[j]);
 	    }
-            for (int j=0; j<Frags_pT[ii].size(); j++){
-                if (J.flavor==4) Frags_D_pT[ii][j] += sigma_gen*J.dNdpT[j];
-		if (J.flavor==5) Frags_B_pT[ii][j] += sigma_gen*J.dNdpT[j];
-		Frags_pT[ii][j] += sigma_gen*J.dNdpT[j];
+            for (int j=0; j<Frags_pT.ny(); j++){
+                if (J.flavor==4) Frags_D_pT.fill(Frags_D_pT.index(ii, j), sigma_gen*J.dNdpT[j]);
+		if (J.flavor==5) Frags_B_pT.fill(Frags_B_pT.index(ii, j), sigma_gen*J.dNdpT[j]);
+		Frags_pT.fill(Frags_pT.index(ii, j), sigma_gen*J.dNdpT[j]);
 	    }
         }
     }
@@ -1074,19 +1173,13 @@ void JetStatistics::add_event(std::vector<Fjet> jets, double sigma_gen, fourvec
         for (auto & J : jets){
 	    bool interested = (J.R<R+.01) && (J.R>R-.01);
             if ( !interested ) continue;
-            int ii=-1;
-            for (int i=0; i<Frag_pTbins.size()-1; i++){
-                if ((Frag_pTbins[i]<J.pT) && (J.pT<Frag_pTbins[i+1])) {
-                    ii = i;
-                    break;
-                }
-            }
+            int ii = D_in_jet[iR].xaxis().find(J.pT);
             if (ii<0) continue;
-	    if (J.flavor==4) D_in_jet_W[iR][ii] += J.sigma;
-	    if (J.flavor==5) B_in_jet_W[iR][ii] += J.sigma;
-            for (int j=0; j<D_in_jet[iR][ii].size(); j++){
-                if (J.flavor==4) D_in_jet[iR][ii][j] += J.sigma*J.dDdz[j];
-		if (J.flavor==5) B_in_jet[iR][ii][j] += J.sigma*J.dBdz[j];
+	    if (J.flavor==4) D_in_jet_W[iR].fill(ii, J.sigma);
+	    if (J.flavor==5) B_in_jet_W[iR].fill(ii, J.sigma);
+            for (size_t j=0; j<D_in_jet[iR].ny(); j++){
+                if (J.flavor==4) D_in_jet[iR].fill(D_in_jet[iR].index(ii, j), J.sigma*J.dDdz[j]);
+		if (J.flavor==5) B_in_jet[iR].fill(B_in_jet[iR].index(ii, j), J.sigma*J.dBdz[j]);
 	    }
         }
     }
@@ -1107,23 +1200,17 @@ void JetStatistics::add_event(std::vector<Fjet> jets, double sigma_gen, fourvec
         if (iR==Rs.size()) continue;
         if (std::abs(J.eta) < 0.9-J.R){
             // check jet pT cut
-            int ii=-1;
-            for (int i=0; i<NpT; i++){
-                if ( (pTbins[i]<J.pT) && (J.pT<pTbins[i+1]) ) {
-                    ii = i;
-                    break;
-                }
-            }
+            int ii = dsigmadpT[iR].xaxis().find(J.pT);
             if (ii<0) continue;
-            if (J.flavor==4) dDdpT[iR][ii] += sigma_gen;
-            if (J.flavor==5) dBdpT[iR][ii] += sigma_gen;
-            dsigmadpT[iR][ii] += sigma_gen;
-            JQ2[iR][ii][0] += sigma_gen * std::cos(2.*J.phi);
-            JQ2[iR][ii][1] += sigma_gen * std::sin(2.*J.phi);
-            JQ3[iR][ii][0] += sigma_gen * std::cos(3.*J.phi);
-            JQ3[iR][ii][1] += sigma_gen * std::sin(3.*J.phi);
-	    JQ4[iR][ii][0] += sigma_gen * std::cos(4.*J.phi);
-            JQ4[iR][ii][1] += sigma_gen * std::sin(4.*J.phi);
+            if (J.flavor==4) dDdpT[iR].fill(ii, sigma_gen);
+            if (J.flavor==5) dBdpT[iR].fill(ii, sigma_gen);
+            dsigmadpT[iR].fill(ii, sigma_gen);
+            JQ2[iR].fill(JQ2[iR].index(ii, 0, 0), sigma_gen * std::cos(2.*J.phi));
+            JQ2[iR].fill(JQ2[iR].index(ii, 0, 1), sigma_gen * std::sin(2.*J.phi));
+            JQ3[iR].fill(JQ3[iR].index(ii, 0, 0), sigma_gen * std::cos(3.*J.phi));
+            JQ3[iR].fill(JQ3[iR].index(ii, 0, 1), sigma_gen * std::sin(3.*J.phi));
+	    JQ4[iR].fill(JQ4[iR].index(ii, 0, 0), sigma_gen * std::cos(4.*J.phi));
+            JQ4[iR].fill(JQ4[iR].index(ii, 0, 1), sigma_gen * std::sin(4.*J.phi));
         }
     }     
 }
@@ -1139,9 +1226,9 @@ void JetStatistics::write(std::string fheader){
             f    << (pTbins[i]+pTbins[i+1])/2. << " "
                  << pTbins[i] << " "
                  << pTbins[i+1] << " "
-                 << dsigmadpT[iR][i]/binwidth[i] << " " 
-                 << dDdpT[iR][i]/binwidth[i] << " "
-                 << dBdpT[iR][i]/binwidth[i] <<  std::endl;
+                 << dsigmadpT[iR].sumw(i)/binwidth[i] << " " 
+                 << dDdpT[iR].sumw(i)/binwidth[i] << " "
+                 << dBdpT[iR].sumw(i)/binwidth[i] <<  std::endl;
         }
         f.close();
 
@@ -1152,10 +1239,10 @@ void JetStatistics::write(std::string fheader){
             f2   << (pTbins[i]+pTbins[i+1])/2. << " "
                  << pTbins[i] << " "
                  << pTbins[i+1] << " "
-                 << dsigmadpT[iR][i] << " " 
-                 << JQ2[iR][i][0] << " " << JQ2[iR][i][1] << " " 
-                 << JQ3[iR][i][0] << " " << JQ3[iR][i][1] << " "
-		 << JQ4[iR][i][0] << " " << JQ4[iR][i][1] 
+                 << dsigmadpT[iR].sumw(i) << " " 
+                 << JQ2[iR].sumw(JQ2[iR].index(i, 0, 0)) << " " << JQ2[iR].sumw(JQ2[iR].index(i, 0, 1)) << " " 
+                 << JQ3[iR].sumw(JQ3[iR].index(i, 0, 0)) << " " << JQ3[iR].sumw(JQ3[iR].index(i, 0, 1)) << " "
+		 << JQ4[iR].sumw(JQ4[iR].index(i, 0, 0)) << " " << JQ4[iR].sumw(JQ4[iR].index(i, 0, 1)) 
                  <<  std::endl;
         }
         f2.close();*/
@@ -1168,12 +1255,12 @@ void JetStatistics::write(std::string fheader){
     f1 << "#";
     for (auto it : Frag_zbins) f1 << it << " ";
     f1 << std::endl;
-    for (int i=0; i<Frags.size(); i++) {
+    for (int i=0; i<Frags.nx(); i++) {
         f1   << (Frag_pTbins[i]+Frag_pTbins[i+1])/2. << " "
              << Frag_pTbins[i] << " "
-             << Frag_pTbins[i+1] << " " << Frags_W[i] << " ";
-        for (int j=0; j<Frags[i].size(); j++){
-            f1 << Frags[i][j] << " " ;
+             << Frag_pTbins[i+1] << " " << Frags_W.sumw(i) << " ";
+        for (int j=0; j<Frags.ny(); j++){
+            f1 << Frags.sumw(Frags.index(i, j)) << " " ;
         }
         f1 << std::endl;
     }
@@ -1185,12 +1272,12 @@ void JetStatistics::write(std::string fheader){
     f15 << "#";
     for (auto it : Frag_zpTbins) f15 << it << " ";
     f15 << std::endl;
-    for (int i=0; i<Frags_pT.size(); i++) {
+    for (int i=0; i<Frags_pT.nx(); i++) {
         f15   << (Frag_pTbins[i]+Frag_pTbins[i+1])/2. << " "
              << Frag_pTbins[i] << " "
-             << Frag_pTbins[i+1] << " " << Frags_W[i] << " ";
-        for (int j=0; j<Frags_pT[i].size(); j++){
-            f15 << Frags_pT[i][j] << " " ;
+             << Frag_pTbins[i+1] << " " << Frags_W.sumw(i) << " ";
+        for (int j=0; j<Frags_pT.ny(); j++){
+            f15 << Frags_pT.sumw(Frags_pT.index(i, j)) << " " ;
         }
         f15 << std::endl;
     }
@@ -1203,12 +1290,12 @@ void JetStatistics::write(std::string fheader){
     f11 << "#";
     for (auto it : Frag_zbins) f11 << it << " ";
     f11 << std::endl;
-    for (int i=0; i<Frags_D.size(); i++) {
+    for (int i=0; i<Frags_D.nx(); i++) {
         f11   << (Frag_pTbins[i]+Frag_pTbins[i+1])/2. << " "
              << Frag_pTbins[i] << " "
-             << Frag_pTbins[i+1] << " " << Frags_D_W[i] << " ";;
-        for (int j=0; j<Frags_D[i].size(); j++){
-            f11 << Frags_D[i][j] << " " ;
+             << Frag_pTbins[i+1] << " " << Frags_D_W.sumw(i) << " ";;
+        for (int j=0; j<Frags_D.ny(); j++){
+            f11 << Frags_D.sumw(Frags_D.index(i, j)) << " " ;
         }
         f11 << std::endl;
     }
@@ -1220,12 +1307,12 @@ void JetStatistics::write(std::string fheader){
     f111 << "#";
     for (auto it : Frag_zpTbins) f111 << it << " ";
     f111 << std::endl;
-    for (int i=0; i<Frags_pT.size(); i++) {
+    for (int i=0; i<Frags_pT.nx(); i++) {
         f111   << (Frag_pTbins[i]+Frag_pTbins[i+1])/2. << " "
              << Frag_pTbins[i] << " "
-             << Frag_pTbins[i+1] << " " << Frags_D_W[i] << " ";
-        for (int j=0; j<Frags_D_pT[i].size(); j++){
-            f111 << Frags_D_pT[i][j] << " " ;
+             << Frag_pTbins[i+1] << " " << Frags_D_W.sumw(i) << " ";
+        for (int j=0; j<Frags_D_pT.ny(); j++){
+            f111 << Frags_D_pT.sumw(Frags_D_pT.index(i, j)) << " " ;
         }
         f111 << std::endl;
     }
@@ -1237,12 +1324,12 @@ void JetStatistics::write(std::string fheader){
     f12 << "#";
     for (auto it : Frag_zbins) f12 << it << " ";
     f12 << std::endl;
-    for (int i=0; i<Frags_B.size(); i++) {
+    for (int i=0; i<Frags_B.nx(); i++) {
         f12   << (Frag_pTbins[i]+Frag_pTbins[i+1])/2. << " "
              << Frag_pTbins[i] << " "
-             << Frag_pTbins[i+1] << " "  << Frags_B_W[i] << " ";
-        for (int j=0; j<Frags_B[i].size(); j++){
-            f12 << Frags_B[i][j] << " ";
+             << Frag_pTbins[i+1] << " "  << Frags_B_W.sumw(i) << " ";
+        for (int j=0; j<Frags_B.ny(); j++){
+            f12 << Frags_B.sumw(Frags_B.index(i, j)) << " ";
         }
         f12 << std::endl;
     }
@@ -1254,12 +1341,12 @@ void JetStatistics::write(std::string fheader){
     f121 << "#";
     for (auto it : Frag_zpTbins) f121 << it << " ";
     f121 << std::endl;
-    for (int i=0; i<Frags_pT.size(); i++) {
+    for (int i=0; i<Frags_pT.nx(); i++) {
         f121   << (Frag_pTbins[i]+Frag_pTbins[i+1])/2. << " "
              << Frag_pTbins[i] << " "
-             << Frag_pTbins[i+1] << " " << Frags_B_W[i] << " ";
-        for (int j=0; j<Frags_B_pT[i].size(); j++){
-            f121 << Frags_B_pT[i][j] << " " ;
+             << Frag_pTbins[i+1] << " " << Frags_B_W.sumw(i) << " ";
+        for (int j=0; j<Frags_B_pT.ny(); j++){
+            f121 << Frags_B_pT.sumw(Frags_B_pT.index(i, j)) << " " ;
         }
         f121 << std::endl;
     }
@@ -1275,9 +1362,9 @@ void JetStatistics::write(std::string fheader){
     for (int i=0; i<shape_NpT; i++) {
         f2   << (shape_pTbins[i]+shape_pTbins[i+1])/2. << " "
              << shape_pTbins[i] << " "
-             << shape_pTbins[i+1] << " " << Shape_W[i] << " ";
-        for (int j=0; j<shapes[i].size(); j++){
-            f2 << shapes[i][j] << " "; 
+             << shape_pTbins[i+1] << " " << Shape_W.sumw(i) << " ";
+        for (int j=0; j<shapes.ny(); j++){
+            f2 << shapes.sumw(shapes.index(i, j)) << " "; 
         }
         f2 << std::endl;
     }
@@ -1292,9 +1379,9 @@ void JetStatistics::write(std::string fheader){
     for (int i=0; i<shape_NpT; i++) {
         f3   << (shape_pTbins[i]+shape_pTbins[i+1])/2. << " "
              << shape_pTbins[i] << " "
-             << shape_pTbins[i+1] << " " << Shape_D_W[i] << " ";
-        for (int j=0; j<Dshapes[i].size(); j++){
-            f3 << Dshapes[i][j] << " "; 
+             << shape_pTbins[i+1] << " " << Shape_D_W.sumw(i) << " ";
+        for (int j=0; j<Dshapes.ny(); j++){
+            f3 << Dshapes.sumw(Dshapes.index(i, j)) << " "; 
         }
         f3 << std::endl;
     }
@@ -1309,9 +1396,9 @@ void JetStatistics::write(std::string fheader){
     for (int i=0; i<shape_NpT; i++) {
         f4   << (shape_pTbins[i]+shape_pTbins[i+1])/2. << " "
              << shape_pTbins[i] << " "
-             << shape_pTbins[i+1] << " " << Shape_B_W[i] << " ";
-        for (int j=0; j<Bshapes[i].size(); j++){
-            f4 << Bshapes[i][j] << " "; 
+             << shape_pTbins[i+1] << " " << Shape_B_W.sumw(i) << " ";
+        for (int j=0; j<Bshapes.ny(); j++){
+            f4 << Bshapes.sumw(Bshapes.index(i, j)) << " "; 
         }
         f4 << std::endl;
     }
@@ -1320,12 +1407,12 @@ void JetStatistics::write(std::string fheader){
     std::stringstream filename5;
     filename5 << fheader << "-xJ.dat";
     std::ofstream f5(filename5.str());
-    for (int i=0; i<xJ.size(); i++){
+    for (int i=0; i<xJ.nx(); i++){
 	f5 << (xJ_pTbins[i]+xJ_pTbins[i+1])/2. << " "
 	   << xJ_pTbins[i] << " "
-           << xJ_pTbins[i+1] << " " << xJ_W[i] << " ";
-        for (int j=0; j<xJ[i].size(); j++) {
-            f5 << xJ[i][j] << " ";
+           << xJ_pTbins[i+1] << " " << xJ_W.sumw(i) << " ";
+        for (int j=0; j<xJ.ny(); j++) {
+            f5 << xJ.sumw(xJ.index(i, j)) << " ";
         }
 	f5 << std::endl;
     }
@@ -1338,8 +1425,8 @@ void JetStatistics::write(std::string fheader){
             f55    << (pTbins[i]+pTbins[i+1])/2. << " "
                  << pTbins[i] << " "
                  << pTbins[i+1] << " "
-                 << leading_yield[i]/binwidth[i] << " "
-                 << subleading_yield[i]/binwidth[i] << std::endl;
+                 << leading_yield.sumw(i)/binwidth[i] << " "
+                 << subleading_yield.sumw(i)/binwidth[i] << std::endl;
     }
     f55.close();
    
@@ -1351,12 +1438,12 @@ void JetStatistics::write(std::string fheader){
     f100 << "#";
     for (auto it : Frag_zbins) f100 << it << " ";
     f100 << std::endl;
-    for (int i=0; i<D_in_jet[iR].size(); i++) {
+    for (int i=0; i<D_in_jet[iR].nx(); i++) {
         f100   << (Frag_pTbins[i]+Frag_pTbins[i+1])/2. << " "
              << Frag_pTbins[i] << " "
-             << Frag_pTbins[i+1] << " " << D_in_jet_W[iR][i] << " ";
-        for (int j=0; j<D_in_jet[iR][i].size(); j++){
-            f100 << D_in_jet[iR][i][j] << " " ;
+             << Frag_pTbins[i+1] << " " << D_in_jet_W[iR].sumw(i) << " ";
+        for (int j=0; j<D_in_jet[iR].ny(); j++){
+            f100 << D_in_jet[iR].sumw(D_in_jet[iR].index(i, j)) << " " ;
         }
         f100 << std::endl;
     }
@@ -1368,12 +1455,12 @@ void JetStatistics::write(std::string fheader){
     f200 << "#";
     for (auto it : Frag_zbins) f200 << it << " ";
     f200 << std::endl;
-    for (int i=0; i<D_in_jet[iR].size(); i++) {
+    for (size_t i=0; i<D_in_jet[iR].nx(); i++) {
         f200   << (Frag_pTbins[i]+Frag_pTbins[i+1])/2. << " "
              << Frag_pTbins[i] << " "
-             << Frag_pTbins[i+1] << " " << D_in_jet_W[iR][i] << " ";
-        for (int j=0; j<D_in_jet[iR][i].size(); j++){
-            f200 << D_in_jet[iR][i][j] << " " ;
+             << Frag_pTbins[i+1] << " " << D_in_jet_W[iR].sumw(i) << " ";
+        for (size_t j=0; j<D_in_jet[iR].ny(); j++){
+            f200 << D_in_jet[iR].sumw(D_in_jet[iR].index(i, j)) << " " ;
         }
         f200 << std::endl;
     }
@@ -1384,27 +1471,15 @@ void JetStatistics::write(std::string fheader){
 JetHFCorr::JetHFCorr(std::vector<double> _rbins):
 pTHFbins({4,20,2000}), 
 rbins(_rbins){
-    dDdr_W.resize(pTHFbins.size());
-    for (auto & it: dDdr_W) it=0.;
-    dBdr_W.resize(pTHFbins.size());
-    for (auto & it: dBdr_W) it=0.;
-
-    dDdr.clear();
-    dDdr.resize(pTHFbins.size());
-    for (auto & it: dDdr){
-        it.resize(rbins.size());
-        for (auto & iit: it) iit = 0.;
-    }
-    dBdr.clear();
-    dBdr.resize(pTHFbins.size());
-    for (auto & it: dBdr){
-        it.resize(rbins.size());
-        for (auto & iit: it) iit = 0.;
-    }
+    HistAxis pTHF(pTHFbins), r(rbins);
+    dDdr_W = Histogram(pTHF);
+    dBdr_W = Histogram(pTHF);
+    dDdr = Histogram(pTHF, r);
+    dBdr = Histogram(pTHF, r);
 }
 
-void JetHFCorr::add_event(std::vector<Fjet> jets, 
-                  std::vector<particle> HFs, 
+void JetHFCorr::add_event(const std::vector<Fjet> & jets, 
+                  const std::vector<particle> & HFs, 
                   double sigma_gen){
     for (auto & J : jets){
         if (std::abs(J.eta)<1.6 && std::abs(J.pT)>60. 
@@ -1416,35 +1491,23 @@ void JetHFCorr::add_event(std::vector<Fjet> jets,
                     double deta = J.eta-p.p.pseudorap();
                     double dR = std::sqrt(absdphi*absdphi + deta*deta);
                     // find r index
-                    int rindex = -1;
-                    for (int i=0; i<rbins.size()-1; i++){
-                        if (rbins[i]<dR && dR<rbins[i+1]){
-                            rindex = i;
-                            break;
-                        }
-                    }
+                    int rindex = dDdr.yaxis().find(dR);
                     if (rindex==-1) continue;
                     // find pT index
-                    int pTindex = -1;
-                    for (int i=0; i<pTHFbins.size()-1; i++){
-                        if (pTHFbins[i]<p.p.xT() && p.p.xT()<pTHFbins[i+1]){
-                            pTindex = i;
-                            break;
-                        }
-                    }
+                    int pTindex = dDdr.xaxis().find(p.p.xT());
                     if (pTindex==-1) continue;      
                     int absid = std::abs(p.pid);
                     if (absid == 4 || 
                         absid == 411 || absid == 421 ||
                         absid == 413 || absid == 423) {
-                        dDdr[pTindex][rindex] += sigma_gen;
-                        dDdr_W[pTindex] += sigma_gen;
+                        dDdr.fill(dDdr.index(pTindex, rindex), sigma_gen);
+                        dDdr_W.fill(pTindex, sigma_gen);
                     }    
                     if (absid == 5 ||
                         absid == 511 || absid == 521 ||
                         absid == 513 || absid == 523) {
-                        dBdr[pTindex][rindex] += sigma_gen;
-                        dBdr_W[pTindex] += sigma_gen;
+                        dBdr.fill(dBdr.index(pTindex, rindex), sigma_gen);
+                        dBdr_W.fill(pTindex, sigma_gen);
                     }          
                 }
             }
@@ -1462,9 +1525,9 @@ void JetHFCorr::write(std::string fheader){
     for (int i=0; i<pTHFbins.size()-1; i++) {
         f1   << (pTHFbins[i]+pTHFbins[i+1])/2. << " "
              << pTHFbins[i] << " "
-             << pTHFbins[i+1] << " " << dDdr_W[i] << " ";
+             << pTHFbins[i+1] << " " << dDdr_W.sumw(i) << " ";
         for (int j=0; j<rbins.size()-1; j++){
-            f1 << dDdr[i][j] << " "; 
+            f1 << dDdr.sumw(dDdr.index(i, j)) << " "; 
         }
         f1 << std::endl;
     }
@@ -1479,9 +1542,9 @@ void JetHFCorr::write(std::string fheader){
     for (int i=0; i<pTHFbins.size()-1; i++) {
         f2   << (pTHFbins[i]+pTHFbins[i+1])/2. << " "
              << pTHFbins[i] << " "
-             << pTHFbins[i+1] << " " << dBdr_W[i] << " ";
+             << pTHFbins[i+1] << " " << dBdr_W.sumw(i) << " ";
         for (int j=0; j<rbins.size()-1; j++){
-            f2 << dBdr[i][j] << " "; 
+            f2 << dBdr.sumw(dBdr.index(i, j)) << " "; 
         }
         f2 << std::endl;
     }
@@ -4,10 +4,13 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <memory>
 #include "Pythia8/Pythia.h"
 #include "Pythia8Plugins/FastJet3.h"
 #include "lorentz.h"
 #include "TableBase.h"
+#include "MappedTable.h"
+#include "Histogram.h"
 #include "predefine.h"
 
 class MediumResponse{
@@ -15,13 +18,39 @@ private:
     // A table for response dot fucntion G^mu,
     // the response is G \cdot Delta P
     std::shared_ptr<TableBase<fourvec, 4>> Gmu;
+    // the same table in the flat format used for interpolation, either
+    // memory-mapped from a flat table file or copied from Gmu
+    std::shared_ptr<MappedTable> GmuFlat;
     std::string name;
-    void compute(int start, int end);
+    // the table only covers rap >= 0 and phi >= 0, negative values are 
+    // obtained by reflection
+    bool folded;
+    void compute(size_t i, double * gmu);
+    void grid(std::vector<size_t> & shape, std::vector<double> & low,
+              std::vector<double> & high);
+    bool read_checkpoint(std::string fname, std::vector<double> & values);
+    void flatten(void);
 public:
     MediumResponse(std::string fname);
+    // a table on a finer or coarser (rap, phi, pTmin/T, vperp) grid
+    MediumResponse(std::string fname, std::vector<size_t> shape);
     double get_dpT_dydphi(double y, double phi, fourvec Pmu, double vperp, double pTmin);
-    void init(std::string);
+    // batched version for n (y, phi, Pmu) triplets at fixed vperp and pTmin
+    void get_dpT_dydphi(size_t n, const double * y, const double * phi, 
+                        const fourvec * Pmu, double vperp, double pTmin, 
+                        double * dpT);
+    // the four components of G^mu at n (y, phi) points, gmu[4*i+mu]
+    void get_Gmu(size_t n, const double * y, const double * phi, 
+                 double vperp, double pTmin, double * gmu);
+    // compute the table and save it to a HDF5 file. The progress is saved
+    // to <file>.partial every checkpoint_interval seconds and a run 
+    // continues from such a checkpoint if there is one.
+    void init(std::string, double checkpoint_interval=600.);
+    // load either a HDF5 table or a flat table; HDF5 tables of the old
+    // unfolded grid are accepted, other grids throw
     void load(std::string);
+    // write the loaded table in the flat format
+    void convert(std::string);
 };
 
 template <typename T>
@@ -61,15 +90,38 @@ void TestSource(
              std::string fname
      );
 
+// (eta, phi) cell index of a particle list, so that particles close to a
+// jet axis can be found without looping over the whole event
+class EtaPhiGrid{
+public:
+    EtaPhiGrid(double etamin, double etamax, double cell);
+    void build(const std::vector<particle> & plist);
+    // indices (in ascending order) of all particles in the cells that 
+    // overlap the disc of radius R around (eta, phi)
+    void query(double eta, double phi, double R, 
+               std::vector<size_t> & result) const;
+private:
+    int eta_cell(double eta) const;
+    int phi_cell(double phi) const;
+    const double etamin, etamax, cell;
+    const int Neta, Nphi;
+    // particles of cell c are items[start[c]..start[c+1]]
+    std::vector<size_t> start, items;
+};
+
 class JetFinder{
 public:
     JetFinder(int Neta, int Nphi, double etamax, bool read_table, std::string stable_path);
     JetFinder(int Neta, int Nphi, double etamax);
+    // share an already initialized response table, e.g. between the
+    // jet finders of several analysis threads; the table is read-only
+    JetFinder(int Neta, int Nphi, double etamax, 
+              std::shared_ptr<MediumResponse> response);
     void MakeETower(double vradial, 
                    double Tfreeze, 
                    double pTmin,
-                   std::vector<particle> plist, 
-                   std::vector<current> TypeOneSources,
+                   const std::vector<particle> & plist, 
+                   const std::vector<current> & TypeOneSources,
                    int coarse_level,
 		   bool charged_jet);
     void set_sigma(double _sigma){
@@ -80,41 +132,62 @@ public:
                   double jetyMin, 
                   double jetyMax, 
 		  bool charged_trigger);
-    void FindHF(std::vector<particle> plist);
+    void FindHF(const std::vector<particle> & plist);
     void CalcJetshape(std::vector<double> rbins);
     void Frag(std::vector<double> zbins, std::vector<double>  zpTbins);
     void LabelFlavor();
     std::vector<Fjet> Jets;
     std::vector<particle> HFs;
-    std::vector<std::vector<double> > PT;
+    // towers, PT[ieta*Nphi+iphi]
+    std::vector<double> PT;
 private:
     int corp_index(double x, double xL, double xH, double dx, int Nx){
         if (x<xL || x>xH) return -1;
         else if (x==xH) return Nx-1;
         else return int((x-xL)/dx);
     };
+    void MakeKernel(int coarseNeta, int coarseNphi, 
+                    double coarsedeta, double coarsedphi, double pTmin);
+    // tower offsets from the tower of the jet axis that are summed up into
+    // a jet of radius R: row r covers the eta offset deta[r] and the phi
+    // offsets -dphi[r]..dphi[r]
+    struct Stencil{
+        std::vector<int> deta, dphi;
+    };
+    Stencil MakeStencil(double R) const;
+    // one stencil per radius of the last FindJets
+    std::vector<Stencil> stencils;
     const int Neta, Nphi;
     const double etamax, etamin, phimax, phimin;
     const double deta, dphi;
     double sigma, vradial, Tfreeze;
-    std::vector<particle> plist;
+    // the particle list of the last MakeETower, not owned by JetFinder,
+    // it has to stay alive until the analysis of the event is done
+    const std::vector<particle> * plist;
     std::vector<current> clist;
     std::vector<double> Rs;
-    MediumResponse MR;
-    std::vector<std::vector<fourvec> > Pmu;
-    Pythia8::Pythia HF2mu;
-    std::map<int,double> BRs;
+    std::shared_ptr<MediumResponse> MR;
+    std::vector<fourvec> Pmu;
+    std::vector<double> coarsePT;
+    EtaPhiGrid plist_grid, HF_grid;
+    // G^mu of a coarse source tabulated on the coarse grid, indexed by 
+    // [(ieta-isource+coarseNeta-1)*coarseNphi+iphi]*4+mu, for pTmin=0 (0) 
+    // and pTmin/Tfreeze (1); cached for the last vradial and pTmin/Tfreeze
+    std::vector<double> kernel[2];
+    int kernel_Neta, kernel_Nphi;
+    double kernel_vradial, kernel_pTmin;
 };
 
 class LeadingParton{
    public:
    LeadingParton();
-   void add_event(std::vector<particle> plist, double sigma_gen);
+   void add_event(const std::vector<particle> & plist, double sigma_gen);
    void write(std::string fheader);
    private:
-   std::vector<double> pTbins, binwidth, nchg, npi, nstrange, nD, nB;
-   std::vector<std::vector<double> > v2chg, v2strange, v2pi, v2D, v2B,
-                        v3chg, v3strange, v3pi, v3D, v3B;
+   std::vector<double> pTbins, binwidth;
+   Histogram nchg, npi, nstrange, nD, nB;
+   Histogram v2chg, v2strange, v2pi, v2D, v2B,
+             v3chg, v3strange, v3pi, v3D, v3B;
    int NpT;
 };
 
@@ -124,37 +197,39 @@ class JetStatistics{
       std::vector<double> shaperbins, 
       std::vector<double> Fragszbins, 
       std::vector<double> FragszpTbins);
-   void add_event(std::vector<Fjet> jets, double sigma_gen, fourvec x0);
+   void add_event(const std::vector<Fjet> & jets, double sigma_gen, const fourvec & x0);
    void write(std::string fheader);
    private:
    std::vector<double> pTbins, binwidth, 
 	   shape_pTbins, shape_rbins, 
-	   xJbins, xJ_pTbins, xJ_W, 
-	   Frag_pTbins, Frag_zbins, Frag_zpTbins, 
-           Frags_W, Frags_D_W, Frags_B_W,
+	   xJbins, xJ_pTbins,
+	   Frag_pTbins, Frag_zbins, Frag_zpTbins;
+   std::vector<double> Rs;
+   // (jet pT) and (jet pT, x) histograms
+   Histogram xJ_W, Frags_W, Frags_D_W, Frags_B_W,
            Shape_W, Shape_D_W, Shape_B_W,
            leading_yield, subleading_yield;
-   std::vector<std::vector<std::vector<double> > > JQ2, JQ3, JQ4,  D_in_jet, B_in_jet;
-   std::vector<double> Rs;
-   std::vector<std::vector<double> > shapes, xJ, 
+   Histogram shapes, xJ, 
 	   Dshapes, Bshapes, 
-	   dsigmadpT, dBdpT, dDdpT,
 	   Frags, Frags_pT, 
            Frags_D, Frags_D_pT,
-           Frags_B, Frags_B_pT,
-           DijetInfo,  D_in_jet_W, B_in_jet_W;
+           Frags_B, Frags_B_pT;
+   // one histogram per jet radius
+   std::vector<Histogram> JQ2, JQ3, JQ4, D_in_jet, B_in_jet,
+	   dsigmadpT, dBdpT, dDdpT,
+           D_in_jet_W, B_in_jet_W;
    int NpT, shape_NpT, shape_Nr;
 };
 
 class JetHFCorr{
    public:
    JetHFCorr(std::vector<double> rbins);
-   void add_event(std::vector<Fjet> jets, std::vector<particle> HFs, 
+   void add_event(const std::vector<Fjet> & jets, const std::vector<particle> & HFs, 
                   double sigma_gen);
    void write(std::string fheader);
    private:
-   std::vector<double> pTHFbins, rbins, dDdr_W, dBdr_W;
-   std::vector<std::vector<double> > dDdr, dBdr;
+   std::vector<double> pTHFbins, rbins;
+   Histogram dDdr_W, dBdr_W, dDdr, dBdr;
 };
 
 #endif